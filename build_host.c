@@ -1,5 +1,6 @@
 #include "src/colla/build.c"
 #include "src/cr.c"
+#include "src/gpucache.c"
 #include "src/host_main.c"
 
 #include "src/sokol/sokol.c"
@@ -21,13 +21,7 @@ CR_EXPORT int cr_init(cr_t *ctx) {
 
     host->bind.fs.samplers[SLOT_NoiseSampler] = host->noise_sampler;
 
-    if (host->shader.id) {
-        host->destroy_shader(host->shader);
-    }
-    if (host->pip.id) {
-        host->destroy_pipeline(host->pip);
-    }
-
+    // owned by the host, returns the objects from the last version if nothing changed
     host->shader = host->make_shader(shader_shader_desc(host->backend));
 
     host->pip = host->make_pipeline(&(sg_pipeline_desc){
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdatomic.h>
 
 #include "vmem.h"
 #include "tracelog.h"
@@ -12,22 +13,55 @@ static uintptr_t arena__align(uintptr_t ptr, usize align) {
     return (ptr + (align - 1)) & ~(align - 1);
 }
 
-static arena_t arena__make_virtual(usize size);
+// virtual arenas commit at least this much at a time, so small allocations don't each need a syscall
+#define ARENA_COMMIT_GRANULARITY KB(64)
+#define ARENA_CACHE_LINE 64
+
+#if COLLA_MSVC
+#define ARENA_THREAD_LOCAL __declspec(thread)
+#else
+#define ARENA_THREAD_LOCAL _Thread_local
+#endif
+
+static ARENA_THREAD_LOCAL arena_t arena__scratch[ARENA_SCRATCH_COUNT];
+
+static arena_t arena__make_virtual(const arena_desc_t *desc);
 static arena_t arena__make_malloc(usize size);
 static arena_t arena__make_static(byte *buf, usize len);
+static arena_t arena__make_chained(usize size);
 
 static void arena__free_virtual(arena_t *arena);
+static bool arena__commit(arena_t *arena, byte *target);
+static void arena__decommit_policy(arena_t *arena, byte *peak);
 static void arena__free_malloc(arena_t *arena);
+static void arena__free_chained(arena_t *arena);
+static bool arena__chained_grow(arena_t *arena, usize size);
+static usize arena__chained_tell(arena_t *arena);
+static void arena__chained_rewind(arena_t *arena, usize from_start);
+
+#if COLLA_ARENA_TRACK
+static void arena__track_make(arena_t *arena, const arena_desc_t *desc);
+static void arena__track_alloc(const arena_alloc_desc_t *desc, usize waste);
+static void arena__track_free(arena_t *arena);
+#endif
 
 arena_t arenaInit(const arena_desc_t *desc) {
     if (desc) {
+        arena_t arena = {0};
         switch (desc->type) {
-            case ARENA_VIRTUAL: return arena__make_virtual(desc->allocation);
-            case ARENA_MALLOC:  return arena__make_malloc(desc->allocation);
-            case ARENA_STATIC:  return arena__make_static(desc->static_buffer, desc->allocation);
+            case ARENA_VIRTUAL: arena = arena__make_virtual(desc); break;
+            case ARENA_MALLOC:  arena = arena__make_malloc(desc->allocation); break;
+            case ARENA_STATIC:  arena = arena__make_static(desc->static_buffer, desc->allocation); break;
+            case ARENA_CHAINED: arena = arena__make_chained(desc->allocation); break;
+            default: goto failed;
         }
+#if COLLA_ARENA_TRACK
+        arena__track_make(&arena, desc);
+#endif
+        return arena;
     }
 
+failed:
     debug("couldn't init arena: %p %d\n", desc, desc ? desc->type : 0);
     return (arena_t){0};
 }
@@ -37,9 +71,14 @@ void arenaCleanup(arena_t *arena) {
         return;
     }
 
+#if COLLA_ARENA_TRACK
+    arena__track_free(arena);
+#endif
+
     switch (arena->type) {
         case ARENA_VIRTUAL: arena__free_virtual(arena); break;
         case ARENA_MALLOC:  arena__free_malloc(arena);  break;
+        case ARENA_CHAINED: arena__free_chained(arena); break;
         // ARENA_STATIC does not need to be freed
         case ARENA_STATIC:  break;
     }
@@ -47,19 +86,34 @@ void arenaCleanup(arena_t *arena) {
     arena->start = NULL;
     arena->current = NULL;
     arena->end = NULL;
+    arena->committed = NULL;
+    arena->high_water = NULL;
+    arena->pop_peak = NULL;
+    arena->low_rewinds = 0;
     arena->type = 0;
+    arena->flags = 0;
 }
 
 arena_t arenaScratch(arena_t *arena) {
     if (!arena) {
         return (arena_t){0};
     }
-    
+
+    // positions in chained arenas are relative to the first block
+    if (arena->type == ARENA_CHAINED) {
+        return *arena;
+    }
+
     return (arena_t) {
-        .start   = arena->current,
-        .current = arena->current,
-        .end     = arena->end,
-        .type    = arena->type,
+        .start              = arena->current,
+        .current            = arena->current,
+        .end                = arena->end,
+        .committed          = arena->committed,
+        .type               = arena->type,
+        .flags              = arena->flags,
+#if COLLA_ARENA_TRACK
+        .track_id           = arena->track_id,
+#endif
     };
 }
 
@@ -71,8 +125,16 @@ void *arenaAlloc(const arena_alloc_desc_t *desc) {
     usize total = desc->size * desc->count;
     arena_t *arena = desc->arena;
 
+#if COLLA_ARENA_TRACK
+    usize waste = arena__align((uintptr_t)arena->current, desc->align) - (uintptr_t)arena->current;
+#endif
+
     arena->current = (byte *)arena__align((uintptr_t)arena->current, desc->align);
 
+    if (total > arenaRemaining(arena) && arena->type == ARENA_CHAINED && arena__chained_grow(arena, total + desc->align)) {
+        arena->current = (byte *)arena__align((uintptr_t)arena->current, desc->align);
+    }
+
     if (total > arenaRemaining(arena)) {
         if (desc->flags & ALLOC_SOFT_FAIL) {
             return NULL;
@@ -81,36 +143,30 @@ void *arenaAlloc(const arena_alloc_desc_t *desc) {
         abort();
     }
 
-    if (arena->type == ARENA_VIRTUAL) {
-        usize allocated = arenaTell(arena);
-        usize page_end = vmemPadToPage(allocated);
-        usize new_cur = allocated + total;
-
-        if (new_cur > page_end) {
-            usize extra_mem = vmemPadToPage(new_cur - page_end);
-            usize page_size = vmemGetPageSize();
-            // TODO is this really correct?
-            usize num_of_pages = (extra_mem / page_size) + 1;
-
-            assert(num_of_pages > 0);
-
-            if (!vmemCommit(arena->current, num_of_pages + 1)) {
-                if (desc->flags & ALLOC_SOFT_FAIL) {
-                    return NULL;
-                }
-                printf("failed to commit memory for virtual arena, tried to commit %zu pages\n", num_of_pages);
-                exit(1);
+    if (arena->type == ARENA_VIRTUAL && arena->current + total > arena->committed) {
+        if (!arena__commit(arena, arena->current + total)) {
+            if (desc->flags & ALLOC_SOFT_FAIL) {
+                return NULL;
             }
+            printf("failed to commit memory for virtual arena, tried to commit up to %zu bytes\n", arenaTell(arena) + total);
+            exit(1);
         }
     }
 
     byte *ptr = arena->current;
     arena->current += total;
 
+#if COLLA_ARENA_TRACK
+    arena__track_alloc(desc, waste);
+#endif
+
     return desc->flags & ALLOC_NOZERO ? ptr : memset(ptr, 0, total);
 }
 
 usize arenaTell(arena_t *arena) {
+    if (arena && arena->type == ARENA_CHAINED) {
+        return arena__chained_tell(arena);
+    }
     return arena ? arena->current - arena->start : 0;
 }
 
@@ -125,9 +181,23 @@ void arenaRewind(arena_t *arena, usize from_start) {
 
     assert(arenaTell(arena) >= from_start);
 
+    if (arena->type == ARENA_CHAINED) {
+        arena__chained_rewind(arena, from_start);
+        return;
+    }
+
+    // the arena only grows between rewinds, apart from arenaPop which remembers where it trimmed from
+    byte *peak = arena->pop_peak > arena->current ? arena->pop_peak : arena->current;
     arena->current = arena->start + from_start;
+    arena->pop_peak = NULL;
+
+    if (arena->decommit_threshold && arena->owner == arena) {
+        arena__decommit_policy(arena, peak);
+    }
 }
 
+// trims the end of the last allocation, it isn't a rewind for the decommit policy:
+// formatting pops a byte or two all the time and would make its hysteresis useless
 void arenaPop(arena_t *arena, usize amount) {
     if (!arena) {
         return;
@@ -136,25 +206,649 @@ void arenaPop(arena_t *arena, usize amount) {
     if (!position) {
         return;
     }
-    arenaRewind(arena, position - amount);
+
+    assert(position >= amount);
+
+    if (arena->type == ARENA_CHAINED) {
+        arena__chained_rewind(arena, position - amount);
+        return;
+    }
+
+    if (arena->current > arena->pop_peak) {
+        arena->pop_peak = arena->current;
+    }
+    arena->current -= amount;
+}
+
+arena_temp_t arenaTempBegin(arena_t *arena) {
+    return (arena_temp_t){
+        .arena = arena,
+        .pos = arenaTell(arena),
+    };
+}
+
+void arenaTempEnd(arena_temp_t temp) {
+    arenaRewind(temp.arena, temp.pos);
+}
+
+// == SCRATCH ARENAS ===================================================================================================
+
+static bool arena__overlaps(arena_t *a, arena_t *b) {
+    // conflicts are often copies of the scratch arena, so compare the memory they point to
+    return a->start < b->end && b->start < a->end;
+}
+
+arena_temp_t arenaGetScratch(arena_t **conflicts, int conflict_count) {
+    for (int i = 0; i < ARENA_SCRATCH_COUNT; ++i) {
+        arena_t *scratch = &arena__scratch[i];
+
+        bool conflicting = false;
+        for (int c = 0; c < conflict_count; ++c) {
+            if (conflicts[c] && scratch->start && arena__overlaps(scratch, conflicts[c])) {
+                conflicting = true;
+                break;
+            }
+        }
+
+        if (conflicting) {
+            continue;
+        }
+
+        if (!scratch->start) {
+            // a single huge spike shouldn't stay resident for the whole life of the thread
+            *scratch = arenaMake(ARENA_VIRTUAL, ARENA_SCRATCH_SIZE, .decommit_threshold = MB(64), .decommit_keep = MB(4), .owner = scratch);
+        }
+
+        return arenaTempBegin(scratch);
+    }
+
+    fatal("no scratch arena available, passed %d conflicts but there are only %d scratch arenas", conflict_count, ARENA_SCRATCH_COUNT);
+    return (arena_temp_t){0};
+}
+
+void arenaScratchCleanup(void) {
+    for (int i = 0; i < ARENA_SCRATCH_COUNT; ++i) {
+        arenaCleanup(&arena__scratch[i]);
+    }
+}
+
+// == TRACKING =========================================================================================================
+
+#if COLLA_ARENA_TRACK
+
+// both have to be powers of two
+#define ARENA_TRACK_MAX_SITES  1024
+#define ARENA_TRACK_MAX_ARENAS 256
+
+typedef struct {
+    const char *file;
+    int line;
+    uint64 count;
+    uint64 bytes;
+    // largest single allocation
+    uint64 peak;
+    // bytes skipped to align the allocations
+    uint64 waste;
+} arena__track_site_t;
+
+typedef struct {
+    const char *file;
+    int line;
+    arena_type_e type;
+    // copies of the arena, e.g. scratch ones, are measured from the start of the original
+    uint8 *start;
+    usize size;
+    uint64 count;
+    uint64 bytes;
+    usize high_water;
+    bool freed;
+} arena__track_arena_t;
+
+static struct {
+    atomic_flag lock;
+    bool exit_registered;
+    uint32 arena_count;
+    // allocations that didn't fit in the site table, or arenas that didn't fit in the arena table
+    uint64 dropped_sites;
+    uint64 dropped_arenas;
+    arena__track_site_t sites[ARENA_TRACK_MAX_SITES];
+    arena__track_arena_t arenas[ARENA_TRACK_MAX_ARENAS];
+} arena__track = { .lock = ATOMIC_FLAG_INIT };
+
+static const char *arena__type_names[] = {
+    [ARENA_VIRTUAL] = "virtual",
+    [ARENA_MALLOC]  = "malloc",
+    [ARENA_STATIC]  = "static",
+    [ARENA_CHAINED] = "chained",
+};
+
+static void arena__track_lock(void) {
+    while (atomic_flag_test_and_set_explicit(&arena__track.lock, memory_order_acquire)) {
+        // spin
+    }
+}
+
+static void arena__track_unlock(void) {
+    atomic_flag_clear_explicit(&arena__track.lock, memory_order_release);
+}
+
+static void arena__track_exit(void) {
+    arenaTrackDump(NULL, ARENA_TRACK_TEXT);
+}
+
+static void arena__track_register_exit(void) {
+    if (!arena__track.exit_registered) {
+        arena__track.exit_registered = true;
+        atexit(arena__track_exit);
+    }
+}
+
+static arena__track_site_t *arena__track_site(const char *file, int line) {
+    // the same header can end up with a different __FILE__ pointer in every translation unit
+    uint64 hash = 0xcbf29ce484222325ull;
+    for (const char *c = file; *c; ++c) {
+        hash = (hash ^ (uint8)*c) * 0x100000001b3ull;
+    }
+    hash = (hash ^ (uint64)line) * 0x100000001b3ull;
+
+    for (usize i = 0; i < ARENA_TRACK_MAX_SITES; ++i) {
+        arena__track_site_t *site = &arena__track.sites[(hash + i) & (ARENA_TRACK_MAX_SITES - 1)];
+        if (!site->file) {
+            site->file = file;
+            site->line = line;
+            return site;
+        }
+        if (site->line == line && (site->file == file || strcmp(site->file, file) == 0)) {
+            return site;
+        }
+    }
+
+    return NULL;
+}
+
+static void arena__track_make(arena_t *arena, const arena_desc_t *desc) {
+    if (!arena->start || !desc->file) {
+        return;
+    }
+
+    arena__track_lock();
+
+    arena__track_register_exit();
+
+    if (arena__track.arena_count < ARENA_TRACK_MAX_ARENAS) {
+        arena__track.arenas[arena__track.arena_count] = (arena__track_arena_t){
+            .file = desc->file,
+            .line = desc->line,
+            .type = arena->type,
+            .start = arena->start,
+            .size = arena->end - arena->start,
+        };
+        arena->track_id = ++arena__track.arena_count;
+    }
+    else {
+        arena__track.dropped_arenas++;
+    }
+
+    arena__track_unlock();
+}
+
+static void arena__track_alloc(const arena_alloc_desc_t *desc, usize waste) {
+    if (!desc->file) {
+        return;
+    }
+
+    arena_t *arena = desc->arena;
+    uint64 total = (uint64)desc->size * desc->count;
+
+    arena__track_lock();
+
+    arena__track_register_exit();
+
+    arena__track_site_t *site = arena__track_site(desc->file, desc->line);
+    if (site) {
+        site->count++;
+        site->bytes += total;
+        site->waste += waste;
+        if (total > site->peak) {
+            site->peak = total;
+        }
+    }
+    else {
+        arena__track.dropped_sites++;
+    }
+
+    if (arena->track_id) {
+        arena__track_arena_t *rec = &arena__track.arenas[arena->track_id - 1];
+        usize pos = arena->type == ARENA_CHAINED ? arenaTell(arena) : (usize)(arena->current - rec->start);
+        rec->count++;
+        rec->bytes += total;
+        if (pos > rec->high_water) {
+            rec->high_water = pos;
+        }
+    }
+
+    arena__track_unlock();
+}
+
+static void arena__track_free(arena_t *arena) {
+    if (!arena->track_id) {
+        return;
+    }
+
+    arena__track_lock();
+    arena__track.arenas[arena->track_id - 1].freed = true;
+    arena__track_unlock();
+}
+
+static int arena__track_cmp_sites(const void *a, const void *b) {
+    const arena__track_site_t *sa = a, *sb = b;
+    return sa->bytes < sb->bytes ? 1 : sa->bytes > sb->bytes ? -1 : 0;
+}
+
+static void arena__track_json_str(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (const char *c = str; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', fp);
+        }
+        fputc(*c, fp);
+    }
+    fputc('"', fp);
+}
+
+void arenaTrackDump(const char *path, arena_track_format_e format) {
+    FILE *fp = path ? fopen(path, "wb") : stdout;
+    if (!fp) {
+        err("couldn't open arena report %s", path);
+        return;
+    }
+
+    arena__track_lock();
+
+    arena__track_site_t *sites = malloc(sizeof(arena__track.sites));
+    usize site_count = 0;
+    if (sites) {
+        for (usize i = 0; i < ARENA_TRACK_MAX_SITES; ++i) {
+            if (arena__track.sites[i].file) {
+                sites[site_count++] = arena__track.sites[i];
+            }
+        }
+        qsort(sites, site_count, sizeof(*sites), arena__track_cmp_sites);
+    }
+
+    if (format == ARENA_TRACK_JSON) {
+        fprintf(fp, "{\n    \"dropped_sites\": %llu,\n    \"dropped_arenas\": %llu,\n    \"sites\": [",
+            (unsigned long long)arena__track.dropped_sites, (unsigned long long)arena__track.dropped_arenas);
+        for (usize i = 0; i < site_count; ++i) {
+            arena__track_site_t *s = &sites[i];
+            fprintf(fp, "%s\n        { \"file\": ", i ? "," : "");
+            arena__track_json_str(fp, s->file);
+            fprintf(fp, ", \"line\": %d, \"count\": %llu, \"bytes\": %llu, \"peak\": %llu, \"waste\": %llu }",
+                s->line, (unsigned long long)s->count, (unsigned long long)s->bytes,
+                (unsigned long long)s->peak, (unsigned long long)s->waste);
+        }
+        fprintf(fp, "\n    ],\n    \"arenas\": [");
+        for (uint32 i = 0; i < arena__track.arena_count; ++i) {
+            arena__track_arena_t *a = &arena__track.arenas[i];
+            fprintf(fp, "%s\n        { \"file\": ", i ? "," : "");
+            arena__track_json_str(fp, a->file);
+            fprintf(fp, ", \"line\": %d, \"type\": \"%s\", \"size\": %zu, \"count\": %llu, \"bytes\": %llu, \"high_water\": %zu, \"freed\": %s }",
+                a->line, arena__type_names[a->type], a->size, (unsigned long long)a->count,
+                (unsigned long long)a->bytes, a->high_water, a->freed ? "true" : "false");
+        }
+        fprintf(fp, "\n    ]\n}\n");
+    }
+    else {
+        fprintf(fp, "== arena report: %zu call sites, %u arenas ==\n", site_count, arena__track.arena_count);
+        fprintf(fp, "%12s %14s %12s %10s  %s\n", "count", "bytes", "peak", "waste", "call site");
+        for (usize i = 0; i < site_count; ++i) {
+            arena__track_site_t *s = &sites[i];
+            fprintf(fp, "%12llu %14llu %12llu %10llu  %s:%d\n",
+                (unsigned long long)s->count, (unsigned long long)s->bytes,
+                (unsigned long long)s->peak, (unsigned long long)s->waste, s->file, s->line);
+        }
+        fprintf(fp, "%12s %14s %12s %10s  %s\n", "count", "bytes", "high water", "type", "arena");
+        for (uint32 i = 0; i < arena__track.arena_count; ++i) {
+            arena__track_arena_t *a = &arena__track.arenas[i];
+            fprintf(fp, "%12llu %14llu %12zu %10s  %s:%d%s\n",
+                (unsigned long long)a->count, (unsigned long long)a->bytes, a->high_water,
+                arena__type_names[a->type], a->file, a->line, a->freed ? " (freed)" : "");
+        }
+        if (arena__track.dropped_sites || arena__track.dropped_arenas) {
+            fprintf(fp, "tables full: %llu allocations and %llu arenas were not recorded\n",
+                (unsigned long long)arena__track.dropped_sites, (unsigned long long)arena__track.dropped_arenas);
+        }
+    }
+
+    arena__track_unlock();
+
+    free(sites);
+    if (path) {
+        fclose(fp);
+    }
+}
+
+void arenaTrackReset(void) {
+    arena__track_lock();
+    memset(arena__track.sites, 0, sizeof(arena__track.sites));
+    arena__track.dropped_sites = 0;
+    arena__track_unlock();
+}
+
+#else
+
+void arenaTrackDump(const char *path, arena_track_format_e format) {
+    (void)path; (void)format;
+}
+
+void arenaTrackReset(void) {
+}
+
+#endif
+
+// == POOL =============================================================================================================
+
+#define ARENA_POOL_SLAB KB(4)
+
+arena_pool_t poolInit(arena_t *arena, usize node_size, usize align) {
+    // every node needs to be able to hold the free list pointer
+    if (node_size < sizeof(void *)) node_size = sizeof(void *);
+    if (align < alignof(void *))    align = alignof(void *);
+    node_size = arena__align(node_size, align);
+
+    // round small nodes up to a power of two when it's cheap, so none of them straddles two cache lines
+    if (node_size < ARENA_CACHE_LINE) {
+        usize pow2 = alignof(void *);
+        while (pow2 < node_size) pow2 *= 2;
+        if (pow2 - node_size <= node_size / 8) {
+            node_size = pow2;
+        }
+    }
+
+    usize slab_size = ARENA_POOL_SLAB > node_size * 8 ? ARENA_POOL_SLAB : node_size * 8;
+
+    return (arena_pool_t){
+        .arena = arena,
+        .node_size = node_size,
+        .slab_size = slab_size - slab_size % node_size,
+    };
+}
+
+void *poolAlloc(arena_pool_t *pool) {
+    return arena__zero(poolAllocNoZero(pool), pool ? pool->node_size : 0);
+}
+
+void *poolAllocNoZero(arena_pool_t *pool) {
+    if (!pool) {
+        return NULL;
+    }
+
+    void *node = pool->free_list;
+    if (node) {
+        pool->free_list = *(void **)node;
+    }
+    else {
+        if (pool->slab_current + pool->node_size > pool->slab_end) {
+            pool->slab_current = alloc(pool->arena, uint8, pool->slab_size, ALLOC_NOZERO, .align = ARENA_CACHE_LINE);
+            pool->slab_end = pool->slab_current + pool->slab_size;
+        }
+        node = pool->slab_current;
+        pool->slab_current += pool->node_size;
+    }
+
+    return node;
+}
+
+void poolFree(arena_pool_t *pool, void *node) {
+    if (!pool || !node) {
+        return;
+    }
+    *(void **)node = pool->free_list;
+    pool->free_list = node;
+}
+
+// == SHARED ARENA =====================================================================================================
+
+// commits are rare and expensive, take a lot at a time
+#define ARENA_SHARED_COMMIT MB(1)
+// number of shared arenas a thread can hold a chunk in at the same time
+#define ARENA_SHARED_CACHE_COUNT 4
+
+struct arena_shared_t {
+    atomic_size_t offset;
+    uint8 pad0[ARENA_CACHE_LINE - sizeof(atomic_size_t)];
+    atomic_size_t committed;
+    atomic_flag commit_lock;
+    uint8 *base;
+    usize size;
+    // changes on reset, so threads don't keep using chunks from before it
+    uint64 id;
+};
+
+typedef struct {
+    uint64 id;
+    uint8 *current;
+    uint8 *end;
+} arena__shared_chunk_t;
+
+static atomic_uint_fast64_t arena__shared_next_id = 1;
+static ARENA_THREAD_LOCAL arena__shared_chunk_t arena__shared_chunks[ARENA_SHARED_CACHE_COUNT];
+
+arena_shared_t *arenaSharedMake(usize size) {
+    arena_shared_t *arena = calloc(1, sizeof(arena_shared_t));
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->base = vmemReserve(size, &arena->size, VMEM_FLAGS_NONE);
+    if (!arena->base) {
+        free(arena);
+        return NULL;
+    }
+
+    arena->id = atomic_fetch_add(&arena__shared_next_id, 1);
+    atomic_init(&arena->offset, 0);
+    atomic_init(&arena->committed, 0);
+    atomic_flag_clear(&arena->commit_lock);
+
+    return arena;
+}
+
+void arenaSharedCleanup(arena_shared_t *arena) {
+    if (!arena) {
+        return;
+    }
+    vmemRelease(arena->base, arena->size);
+    free(arena);
+}
+
+static bool arena__shared_commit(arena_shared_t *arena, usize end) {
+    while (atomic_flag_test_and_set_explicit(&arena->commit_lock, memory_order_acquire)) {
+        // spin, whoever has the lock is probably committing what we need
+    }
+
+    bool success = true;
+    usize committed = atomic_load_explicit(&arena->committed, memory_order_relaxed);
+
+    if (committed < end) {
+        usize target = arena__align(end, ARENA_SHARED_COMMIT);
+        target = target < arena->size ? target : arena->size;
+
+        success = vmemCommit(arena->base + committed, (target - committed) / vmemGetPageSize());
+        if (success) {
+            atomic_store_explicit(&arena->committed, target, memory_order_release);
+        }
+    }
+
+    atomic_flag_clear_explicit(&arena->commit_lock, memory_order_release);
+    return success;
+}
+
+// grabs size bytes straight from the shared pointer
+static uint8 *arena__shared_bump(arena_shared_t *arena, usize size, usize align) {
+    usize total = size + align - 1;
+    usize offset = atomic_fetch_add_explicit(&arena->offset, total, memory_order_relaxed);
+
+    if (offset + total > arena->size) {
+        return NULL;
+    }
+
+    if (atomic_load_explicit(&arena->committed, memory_order_acquire) < offset + total) {
+        if (!arena__shared_commit(arena, offset + total)) {
+            return NULL;
+        }
+    }
+
+    return (uint8 *)arena__align((uintptr_t)(arena->base + offset), align);
+}
+
+void *arenaSharedAlloc(arena_shared_t *arena, usize size, usize align, alloc_flags_e flags) {
+    if (!arena) {
+        return NULL;
+    }
+
+    uint8 *ptr = NULL;
+
+    if (size > ARENA_SHARED_CHUNK / 4) {
+        ptr = arena__shared_bump(arena, size, align);
+    }
+    else {
+        arena__shared_chunk_t *chunk = &arena__shared_chunks[arena->id % ARENA_SHARED_CACHE_COUNT];
+        if (chunk->id != arena->id) {
+            *chunk = (arena__shared_chunk_t){ .id = arena->id };
+        }
+
+        ptr = (uint8 *)arena__align((uintptr_t)chunk->current, align);
+        if (!chunk->current || ptr + size > chunk->end) {
+            // chunks are cache line aligned so two threads never write to the same line
+            uint8 *new_chunk = arena__shared_bump(arena, ARENA_SHARED_CHUNK, ARENA_CACHE_LINE);
+            if (!new_chunk) {
+                ptr = NULL;
+            }
+            else {
+                chunk->current = new_chunk;
+                chunk->end = new_chunk + ARENA_SHARED_CHUNK;
+                ptr = (uint8 *)arena__align((uintptr_t)chunk->current, align);
+            }
+        }
+
+        if (ptr) {
+            chunk->current = ptr + size;
+        }
+    }
+
+    if (!ptr) {
+        if (flags & ALLOC_SOFT_FAIL) {
+            return NULL;
+        }
+        fatal("finished space in shared arena, tried to allocate %zu bytes out of %zu", size, arena->size);
+    }
+
+    return flags & ALLOC_NOZERO ? ptr : memset(ptr, 0, size);
+}
+
+usize arenaSharedTell(arena_shared_t *arena) {
+    if (!arena) {
+        return 0;
+    }
+    usize offset = atomic_load(&arena->offset);
+    return offset < arena->size ? offset : arena->size;
+}
+
+void arenaSharedReset(arena_shared_t *arena) {
+    if (!arena) {
+        return;
+    }
+    atomic_store(&arena->offset, 0);
+    arena->id = atomic_fetch_add(&arena__shared_next_id, 1);
 }
 
 // == VIRTUAL ARENA ====================================================================================================
 
-static arena_t arena__make_virtual(usize size) {
+static arena_t arena__make_virtual(const arena_desc_t *desc) {
+    vmem_flags_e vmem_flags = desc->flags & ARENA_HUGE_PAGES ? VMEM_HUGE_PAGES : VMEM_FLAGS_NONE;
+
     usize alloc_size = 0;
-    byte *ptr = vmemInit(size, &alloc_size);
-    if (!vmemCommit(ptr, 1)) {
-        vmemRelease(ptr);
-        ptr = NULL;
-    }
+    byte *ptr = vmemReserve(desc->allocation, &alloc_size, vmem_flags);
 
-    return (arena_t){
+    arena_t arena = {
         .start = ptr,
         .current = ptr,
         .end = ptr ? ptr + alloc_size : NULL,
+        .committed = ptr,
+        .high_water = ptr,
+        .decommit_threshold = desc->decommit_threshold,
+        .decommit_keep = desc->decommit_keep,
+        .owner = desc->owner,
         .type = ARENA_VIRTUAL,
+        .flags = desc->flags,
     };
+
+    if (ptr && !arena__commit(&arena, ptr + 1)) {
+        vmemRelease(ptr, alloc_size);
+        return (arena_t){0};
+    }
+
+    return arena;
+}
+
+// huge page arenas commit and decommit whole huge pages, so they never get split
+static usize arena__commit_granularity(arena_t *arena) {
+    usize page_size = vmemGetPageSize();
+    usize granularity = arena->flags & ARENA_HUGE_PAGES ? VMEM_HUGE_PAGE_SIZE : ARENA_COMMIT_GRANULARITY;
+    return granularity > page_size ? granularity : page_size;
+}
+
+// commits pages up to target, committed always stays page aligned
+static bool arena__commit(arena_t *arena, byte *target) {
+    usize page_size = vmemGetPageSize();
+    usize granularity = arena__commit_granularity(arena);
+
+    byte *new_committed = (byte *)arena__align((uintptr_t)target, granularity);
+    if (new_committed > arena->end || new_committed < target) {
+        new_committed = arena->end;
+    }
+
+    usize num_of_pages = (new_committed - arena->committed) / page_size;
+    if (!vmemCommit(arena->committed, num_of_pages)) {
+        return false;
+    }
+
+    if (arena->flags & ARENA_PREFAULT) {
+        vmemPrefault(arena->committed, num_of_pages);
+    }
+
+    arena->committed = new_committed;
+    return true;
+}
+
+// counts the low rewinds in a row, after ARENA_DECOMMIT_REWINDS of them the memory
+// past the highest point they reached plus decommit_keep goes back to the os
+static void arena__decommit_policy(arena_t *arena, byte *peak) {
+    if ((usize)(arena->committed - peak) <= arena->decommit_threshold) {
+        arena->low_rewinds = 0;
+        arena->high_water = arena->current;
+        return;
+    }
+
+    if (peak > arena->high_water) {
+        arena->high_water = peak;
+    }
+
+    if (++arena->low_rewinds < ARENA_DECOMMIT_REWINDS) {
+        return;
+    }
+
+    usize page_size = vmemGetPageSize();
+    uintptr_t keep_end = (uintptr_t)arena->high_water + arena->decommit_keep;
+    byte *from = (byte *)arena__align(keep_end < (uintptr_t)arena->end ? keep_end : (uintptr_t)arena->end, arena__commit_granularity(arena));
+
+    if (from < arena->committed && vmemDecommit(from, (arena->committed - from) / page_size)) {
+        arena->committed = from;
+    }
+
+    arena->low_rewinds = 0;
+    arena->high_water = arena->current;
 }
 
 static void arena__free_virtual(arena_t *arena) {
@@ -162,7 +856,7 @@ static void arena__free_virtual(arena_t *arena) {
         return;
     }
 
-    bool success = vmemRelease(arena->start);
+    bool success = vmemRelease(arena->start, arena->end - arena->start);
     assert(success && "Failed arena free");
 }
 
@@ -175,6 +869,7 @@ static arena_t arena__make_malloc(usize size) {
         .start = ptr,
         .current = ptr,
         .end = ptr ? ptr + size : NULL,
+        .committed = ptr ? ptr + size : NULL,
         .type = ARENA_MALLOC,
     };
 }
@@ -190,6 +885,122 @@ static arena_t arena__make_static(byte *buf, usize len) {
         .start = buf,
         .current = buf,
         .end = buf ? buf + len : NULL,
+        .committed = buf ? buf + len : NULL,
         .type = ARENA_STATIC,
     };
 }
+
+// == CHAINED ARENA ====================================================================================================
+
+// lives right before the data of every block. blocks are never freed before arenaCleanup,
+// rewinding keeps them linked after the current one and growing reuses them, this also
+// means copies of the arena that grew can't leak their blocks
+typedef struct arena__block_t {
+    struct arena__block_t *prev;
+    struct arena__block_t *next;
+    // position of the first byte, set every time the block becomes the current one
+    usize base;
+    usize size;
+} arena__block_t;
+
+#define ARENA_CHAINED_MIN_BLOCK KB(4)
+
+static arena__block_t *arena__chained_block(arena_t *arena) {
+    return (arena__block_t *)arena->start - 1;
+}
+
+static void arena__chained_use(arena_t *arena, arena__block_t *block) {
+    arena->start = (byte *)(block + 1);
+    arena->current = arena->start;
+    arena->end = arena->start + block->size;
+    arena->committed = arena->end;
+}
+
+static arena__block_t *arena__chained_new(usize size) {
+    arena__block_t *block = malloc(sizeof(arena__block_t) + size);
+    if (block) {
+        *block = (arena__block_t){ .size = size };
+    }
+    return block;
+}
+
+static arena_t arena__make_chained(usize size) {
+    size = size > ARENA_CHAINED_MIN_BLOCK ? size : ARENA_CHAINED_MIN_BLOCK;
+
+    arena__block_t *block = arena__chained_new(size);
+    assert(block);
+
+    arena_t arena = { .type = ARENA_CHAINED };
+    if (block) {
+        arena__chained_use(&arena, block);
+    }
+    return arena;
+}
+
+static void arena__free_chained(arena_t *arena) {
+    if (!arena->start) {
+        return;
+    }
+
+    arena__block_t *block = arena__chained_block(arena);
+    while (block->prev) {
+        block = block->prev;
+    }
+
+    while (block) {
+        arena__block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+// moves to the next block, or links in a new one if it doesn't exist or is too small
+static bool arena__chained_grow(arena_t *arena, usize size) {
+    if (!arena->start) {
+        return false;
+    }
+
+    arena__block_t *cur = arena__chained_block(arena);
+    arena__block_t *next = cur->next;
+
+    if (!next || next->size < size) {
+        usize new_size = cur->size * 2;
+        next = arena__chained_new(new_size > size ? new_size : size);
+        if (!next) {
+            return false;
+        }
+        next->prev = cur;
+        next->next = cur->next;
+        if (cur->next) {
+            cur->next->prev = next;
+        }
+        cur->next = next;
+    }
+
+    // whatever is left at the end of the current block is skipped
+    next->base = arena__chained_tell(arena);
+    arena__chained_use(arena, next);
+    return true;
+}
+
+static usize arena__chained_tell(arena_t *arena) {
+    if (!arena->start) {
+        return 0;
+    }
+    return arena__chained_block(arena)->base + (arena->current - arena->start);
+}
+
+// only walks back over the blocks being rewound, so it's constant time amortised over the allocations
+static void arena__chained_rewind(arena_t *arena, usize from_start) {
+    if (!arena->start) {
+        return;
+    }
+
+    arena__block_t *block = arena__chained_block(arena);
+    while (block->prev && from_start < block->base) {
+        block = block->prev;
+    }
+
+    arena__chained_use(arena, block);
+    arena->current = arena->start + (from_start - block->base);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string.h>
+
 #include "collatypes.h"
 
 #ifdef __TINYC__
@@ -8,10 +10,20 @@
 #define alignof _Alignof
 #endif
 
+// build with -DCOLLA_ARENA_TRACK=1 to record every alloc() by call site and every arenaMake()
+// by arena, see arenaTrackDump. when it's 0 nothing changes, alloc() still inlines the fast path
+#ifndef COLLA_ARENA_TRACK
+#define COLLA_ARENA_TRACK 0
+#endif
+
 typedef enum {
     ARENA_VIRTUAL,
     ARENA_MALLOC,
     ARENA_STATIC,
+    // list of malloc'd blocks, a new one twice as big is linked when the current one is full.
+    // allocation is the size of the first block. every allocation is contiguous, but two
+    // consecutive ones are not guaranteed to be next to each other, so it can't back an outstream
+    ARENA_CHAINED,
 } arena_type_e;
 
 typedef enum {
@@ -20,42 +32,211 @@ typedef enum {
     ALLOC_SOFT_FAIL  = 1 << 1,
 } alloc_flags_e;
 
+typedef enum {
+    ARENA_FLAGS_NONE = 0,
+    // ARENA_VIRTUAL only, both are applied to the committed part of the arena as it grows.
+    // commits memory in 2MB steps instead of 64KB ones so each step can be a transparent huge
+    // page (see vmem.h), an arena that only ever uses a few KB still takes 2MB
+    ARENA_HUGE_PAGES = 1 << 0,
+    // faults in every page as it gets committed, so allocating doesn't page fault but every
+    // commit step is paid for up front even if only part of it gets used
+    ARENA_PREFAULT   = 1 << 1,
+} arena_flags_e;
+
 typedef struct arena_t {
     uint8 *start;
     uint8 *current;
     uint8 *end;
+    // ARENA_VIRTUAL only, everything before this is readable and writable
+    uint8 *committed;
+    // ARENA_VIRTUAL only, highest point reached by the low rewinds in a row, see arena_desc_t
+    uint8 *high_water;
+    // ARENA_VIRTUAL only, highest point arenaPop trimmed from since the last rewind
+    uint8 *pop_peak;
+    // the only arena_t the decommit policy runs on, copies live somewhere else so they never give memory back
+    struct arena_t *owner;
+    usize decommit_threshold;
+    usize decommit_keep;
+    uint32 low_rewinds;
     arena_type_e type;
+    // ARENA_VIRTUAL only
+    arena_flags_e flags;
+#if COLLA_ARENA_TRACK
+    // 1 + index in the tracking table, 0 for arenas that weren't made with arenaMake. copies keep it
+    uint32 track_id;
+#endif
 } arena_t;
 
+#define ARENA_DECOMMIT_REWINDS 8
+
 typedef struct {
     arena_type_e type;
     usize allocation;
     byte *static_buffer;
+    arena_flags_e flags;
+    // ARENA_VIRTUAL only: a rewind is low when, since the previous one, the arena stayed more
+    // than decommit_threshold bytes below the end of its committed memory. after
+    // ARENA_DECOMMIT_REWINDS low rewinds in a row, everything committed past the highest point
+    // they reached plus decommit_keep is given back to the os. a spike is returned once the
+    // arena has settled, memory that is needed again every few rewinds stays. 0 disables it.
+    // only arenaRewind and arenaTempEnd count as rewinds, arenaPop doesn't.
+    // the policy only runs on owner, the address the arena is stored at, e.g.
+    //     arena_t arena = arenaMake(ARENA_VIRTUAL, GB(1), .decommit_threshold = MB(64), .owner = &arena);
+    // copies, by value or with arenaScratch, never give memory back, so the committed
+    // memory they know about is always still there. what a copy commits is only given
+    // back once the owner gets there and rewinds. without an owner the policy is off
+    usize decommit_threshold;
+    usize decommit_keep;
+    arena_t *owner;
+#if COLLA_ARENA_TRACK
+    const char *file;
+    int line;
+#endif
 } arena_desc_t;
 
+typedef struct {
+    arena_t *arena;
+    usize pos;
+} arena_temp_t;
+
 typedef struct {
     arena_t *arena;
     usize count;
     alloc_flags_e flags;
     usize size;
     usize align;
+#if COLLA_ARENA_TRACK
+    const char *file;
+    int line;
+#endif
 } arena_alloc_desc_t;
 
 #define KB(count) (  (count) * 1024)
 #define MB(count) (KB(count) * 1024)
 #define GB(count) (MB(count) * 1024)
 
-// arena_type_e type, usize allocation, [ byte *static_buffer ]
+#if COLLA_ARENA_TRACK
+
+#define arenaMake(...) arenaInit(&(arena_desc_t){ __VA_ARGS__, .file = __FILE__, .line = __LINE__ })
+// every allocation has to be recorded, so the fast path is skipped
+#define alloc(arenaptr, type, ...) arenaAlloc(&(arena_alloc_desc_t){ .size = sizeof(type), .count = 1, .align = alignof(type), .file = __FILE__, .line = __LINE__, .arena = arenaptr, __VA_ARGS__ })
+
+#else
+
+// arena_type_e type, usize allocation, [ byte *static_buffer, arena_flags_e flags, usize decommit_threshold, usize decommit_keep, arena_t *owner ]
 #define arenaMake(...) arenaInit(&(arena_desc_t){ __VA_ARGS__ })
 
 // arena_t *arena, T type, [ usize count, alloc_flags_e flags, usize size, usize align ]
-#define alloc(arenaptr, type, ...) arenaAlloc(&(arena_alloc_desc_t){ .size = sizeof(type), .count = 1, .align = alignof(type), .arena = arenaptr, __VA_ARGS__ })
+#define alloc(arenaptr, type, ...) arena__alloc_fast(&(arena_alloc_desc_t){ .size = sizeof(type), .count = 1, .align = alignof(type), .arena = arenaptr, __VA_ARGS__ })
+
+#endif
 
 arena_t arenaInit(const arena_desc_t *desc);
 void arenaCleanup(arena_t *arena);
 
+// returns a copy of arena that starts at its current position, without the decommit policy
+arena_t arenaScratch(arena_t *arena);
+
 void *arenaAlloc(const arena_alloc_desc_t *desc);
+
+// allocations that fit below the commit watermark never leave the header,
+// anything else (committing, running out of space, a NULL arena) goes through arenaAlloc
+static inline void *arena__alloc_fast(const arena_alloc_desc_t *desc) {
+    arena_t *arena = desc->arena;
+    if (arena) {
+        uintptr_t ptr = ((uintptr_t)arena->current + (desc->align - 1)) & ~(uintptr_t)(desc->align - 1);
+        usize total = desc->size * desc->count;
+        if (ptr <= (uintptr_t)arena->committed && total <= (uintptr_t)arena->committed - ptr) {
+            arena->current = (uint8 *)(ptr + total);
+            return desc->flags & ALLOC_NOZERO ? (void *)ptr : memset((void *)ptr, 0, total);
+        }
+    }
+    return arenaAlloc(desc);
+}
 usize arenaTell(arena_t *arena);
 usize arenaRemaining(arena_t *arena);
 void arenaRewind(arena_t *arena, usize from_start);
 void arenaPop(arena_t *arena, usize amount);
+
+// saves the position of arena, arenaTempEnd rewinds it back there
+arena_temp_t arenaTempBegin(arena_t *arena);
+void arenaTempEnd(arena_temp_t temp);
+
+// every thread gets its own scratch arenas, they are created the first time they are needed
+#define ARENA_SCRATCH_COUNT 2
+#define ARENA_SCRATCH_SIZE  GB(1)
+
+// returns a temp over one of the calling thread's scratch arenas that isn't in conflicts,
+// pass every arena that the caller could be allocating the result in, e.g.
+//     str_t foo(arena_t *arena) {
+//         arena_temp_t scratch = arenaGetScratch(&arena, 1);
+//         ...
+//         arenaTempEnd(scratch);
+//     }
+// as there are ARENA_SCRATCH_COUNT scratch arenas, at most ARENA_SCRATCH_COUNT - 1 conflicts are supported
+arena_temp_t arenaGetScratch(arena_t **conflicts, int conflict_count);
+// frees the calling thread's scratch arenas, threads created with thrCreate call this before exiting
+void arenaScratchCleanup(void);
+
+// == TRACKING ==================================================
+
+typedef enum {
+    ARENA_TRACK_TEXT,
+    ARENA_TRACK_JSON,
+} arena_track_format_e;
+
+// writes allocation count, bytes, largest allocation and alignment waste of every call site,
+// sorted by bytes, followed by the high water mark of every arena. path NULL writes to stdout.
+// with tracking enabled the text report is also printed at exit. does nothing when COLLA_ARENA_TRACK is 0
+void arenaTrackDump(const char *path, arena_track_format_e format);
+// clears the call site counters, arenas keep their high water marks
+void arenaTrackReset(void);
+
+// == POOL ======================================================
+
+// fixed size nodes carved out of an arena in cache line aligned slabs,
+// freed nodes go in a free list and are handed out again before carving new ones
+typedef struct arena_pool_t {
+    arena_t *arena;
+    void *free_list;
+    uint8 *slab_current;
+    uint8 *slab_end;
+    usize node_size;
+    usize slab_size;
+} arena_pool_t;
+
+// arena_t *arena, T type
+#define poolMake(arenaptr, type) poolInit(arenaptr, sizeof(type), alignof(type))
+// arena_pool_t *pool, T type
+#define poolNew(pool, type) ((type *)arena__zero(poolAllocNoZero(pool), sizeof(type)))
+
+// with a constant size the compiler can clear the node inline
+static inline void *arena__zero(void *ptr, usize size) {
+    return ptr ? memset(ptr, 0, size) : NULL;
+}
+
+arena_pool_t poolInit(arena_t *arena, usize node_size, usize align);
+// returns a zeroed node, NULL if pool is NULL
+void *poolAlloc(arena_pool_t *pool);
+void *poolAllocNoZero(arena_pool_t *pool);
+void poolFree(arena_pool_t *pool, void *node);
+
+// == SHARED ARENA ==============================================
+
+// virtual arena that any number of threads can allocate from at the same time.
+// every thread takes ARENA_SHARED_CHUNK bytes at a time with an atomic add and bumps
+// through them on its own, bigger allocations go straight to the shared pointer
+typedef struct arena_shared_t arena_shared_t;
+
+#define ARENA_SHARED_CHUNK KB(64)
+
+// arena_shared_t *arena, T type, usize count
+#define allocShared(arenaptr, type, count) (type *)arenaSharedAlloc(arenaptr, sizeof(type) * (count), alignof(type), ALLOC_FLAGS_NONE)
+
+arena_shared_t *arenaSharedMake(usize size);
+void arenaSharedCleanup(arena_shared_t *arena);
+void *arenaSharedAlloc(arena_shared_t *arena, usize size, usize align, alloc_flags_e flags);
+// bytes handed out so far, including the unused part of the chunks that threads are holding
+usize arenaSharedTell(arena_shared_t *arena);
+// not thread safe, no other thread can be using the arena
+void arenaSharedReset(arena_shared_t *arena);
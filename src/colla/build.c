@@ -1,10 +1,12 @@
 #include "arena.c"
 #include "base64.c"
-// #include "cthreads.c"
+#include "cthreads.c"
 #include "file.c"
 #include "format.c"
+#include "image.c"
 // #include "http.c"
 #include "ini.c"
+#include "intern.c"
 // #include "json.c"
 // #include "server.c"
 // #include "socket.c"
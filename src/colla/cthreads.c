@@ -2,6 +2,8 @@
 
 #include <stdlib.h>
 
+#include "arena.h"
+
 typedef struct {
     cthread_func_t func;
     void *arg;
@@ -18,7 +20,9 @@ static DWORD _thrFuncInternal(void *arg) {
     cthread_func_t func = params->func;
     void *argument = params->arg;
     free(params);
-    return (DWORD)func(argument);
+    DWORD result = (DWORD)func(argument);
+    arenaScratchCleanup();
+    return result;
 }
 
 cthread_t thrCreate(cthread_func_t func, void *arg) {
@@ -145,7 +149,9 @@ static void *_thrFuncInternal(void *arg) {
     cthread_func_t func = params->func;
     void *argument = params->arg;
     free(params);
-    return INT_TO_VOIDP(func(argument));
+    int result = func(argument);
+    arenaScratchCleanup();
+    return INT_TO_VOIDP(result);
 }
 
 cthread_t thrCreate(cthread_func_t func, void *arg) {
@@ -55,40 +55,6 @@ TCHAR *fileGetFullPath(arena_t *arena, strview_t filename) {
     return full_path;
 }
 
-strview_t fileGetFilename(strview_t path) {
-    usize last_lin = strvRFind(path, '/', 0);
-    usize last_win = strvRFind(path, '\\', 0);
-    last_lin = last_lin != SIZE_MAX ? last_lin : 0;
-    last_win = last_win != SIZE_MAX ? last_win : 0;
-    usize last = max(last_lin, last_win);
-    return strvSub(path, last ? last + 1 : last, SIZE_MAX);
-}
-
-strview_t fileGetExtension(strview_t path) {
-    usize ext_pos = strvRFind(path, '.', 0);
-    return strvSub(path, ext_pos, SIZE_MAX);
-}
-
-void fileSplitPath(strview_t path, strview_t *dir, strview_t *name, strview_t *ext) {
-    usize dir_lin = strvRFind(path, '/', 0);
-    usize dir_win = strvRFind(path, '\\', 0);
-    dir_lin = dir_lin != STR_NONE ? dir_lin : 0;
-    dir_win = dir_win != STR_NONE ? dir_win : 0;
-    usize dir_pos = max(dir_lin, dir_win);
-
-    usize ext_pos = strvRFind(path, '.', 0);
-
-    if (dir) {
-        *dir = strvSub(path, 0, dir_pos);
-    }
-    if (name) {
-        *name = strvSub(path, dir_pos ? dir_pos + 1 : dir_pos, ext_pos);
-    }
-    if (ext) {
-        *ext = strvSub(path, ext_pos, SIZE_MAX);
-    }
-}
-
 bool fileDelete(arena_t scratch, strview_t filename) {
     wchar_t *wfname = strvToWChar(&scratch, filename, NULL);
     return DeleteFileW(wfname);
@@ -188,10 +154,15 @@ static const char *file__mode_to_stdio(filemode_e mode) {
 bool fileExists(const char *name) {
     FILE *fp = fopen(name, "rb");
     bool exists = fp != NULL;
-    fclose(fp);
+    if (fp) fclose(fp);
     return exists;
 }
 
+bool fileDelete(arena_t scratch, strview_t filename) {
+    str_t name = str(&scratch, filename);
+    return remove(name.buf) == 0;
+}
+
 file_t fileOpen(arena_t scratch, strview_t name, filemode_e mode) {
     str_t filename = str(&scratch, name);
     return (file_t) {
@@ -255,10 +226,48 @@ uint64 fileGetTimeFP(file_t ctx) {
 
 #endif
 
+strview_t fileGetFilename(strview_t path) {
+    usize last_lin = strvRFind(path, '/', 0);
+    usize last_win = strvRFind(path, '\\', 0);
+    last_lin = last_lin != SIZE_MAX ? last_lin : 0;
+    last_win = last_win != SIZE_MAX ? last_win : 0;
+    usize last = last_lin > last_win ? last_lin : last_win;
+    return strvSub(path, last ? last + 1 : last, SIZE_MAX);
+}
+
+strview_t fileGetExtension(strview_t path) {
+    usize ext_pos = strvRFind(path, '.', 0);
+    return strvSub(path, ext_pos, SIZE_MAX);
+}
+
+void fileSplitPath(strview_t path, strview_t *dir, strview_t *name, strview_t *ext) {
+    usize dir_lin = strvRFind(path, '/', 0);
+    usize dir_win = strvRFind(path, '\\', 0);
+    dir_lin = dir_lin != STR_NONE ? dir_lin : 0;
+    dir_win = dir_win != STR_NONE ? dir_win : 0;
+    usize dir_pos = dir_lin > dir_win ? dir_lin : dir_win;
+
+    usize ext_pos = strvRFind(path, '.', 0);
+
+    if (dir) {
+        *dir = strvSub(path, 0, dir_pos);
+    }
+    if (name) {
+        *name = strvSub(path, dir_pos ? dir_pos + 1 : dir_pos, ext_pos);
+    }
+    if (ext) {
+        *ext = strvSub(path, ext_pos, SIZE_MAX);
+    }
+}
+
 bool filePutc(file_t ctx, char c) {
     return fileWrite(ctx, &c, 1) == 1;
 }
 
+usize fileSink(void *userdata, const void *buf, usize len) {
+    return fileWrite(*(file_t *)userdata, buf, len);
+}
+
 bool filePuts(file_t ctx, strview_t v) {
     return fileWrite(ctx, v.buf, v.len) == v.len;
 }
@@ -35,6 +35,8 @@ bool filePrintfv(arena_t scratch, file_t ctx, const char *fmt, va_list args);
 
 usize fileRead(file_t ctx, void *buf, usize len);
 usize fileWrite(file_t ctx, const void *buf, usize len);
+// obufsink_fn (see strstream.h), userdata is a file_t *
+usize fileSink(void *userdata, const void *buf, usize len);
 
 bool fileSeekEnd(file_t ctx);
 void fileRewind(file_t ctx);
@@ -2,6 +2,7 @@
 
 #define STB_SPRINTF_DECORATE(name) stb_##name
 #define STB_SPRINTF_NOUNALIGNED
+#define STB_SPRINTF_MIN FMT_CHUNK_SIZE
 #define STB_SPRINTF_IMPLEMENTATION
 #include "stb/stb_sprintf.h"
 
@@ -38,6 +39,10 @@ int fmtBufferv(char *buffer, usize buflen, const char *fmt, va_list args) {
     return stb_vsnprintf(buffer, (int)buflen, fmt, args);
 }
 
+int fmtCallbackv(fmtcallback_fn *callback, void *userdata, char *buffer, const char *fmt, va_list args) {
+    return stb_vsprintfcb(callback, userdata, buffer, fmt, args);
+}
+
 #if 0
 str_t fmtStr(Arena *arena, const char *fmt, ...) {
     va_list args;
@@ -6,8 +6,17 @@
 
 typedef struct arena_t arena_t;
 
+// size of the chunks passed to a fmtcallback_fn, buffers given to fmtCallbackv must hold at least this many chars
+#define FMT_CHUNK_SIZE 512
+
+// called every time a chunk is full and once at the end with what's left, len doesn't include a null terminator.
+// returns the buffer for the next chunk, or NULL to stop formatting
+typedef char *(fmtcallback_fn)(const char *buf, void *userdata, int len);
+
 int fmtPrint(const char *fmt, ...);
 int fmtPrintv(const char *fmt, va_list args);
 
 int fmtBuffer(char *buffer, usize buflen, const char *fmt, ...);
 int fmtBufferv(char *buffer, usize buflen, const char *fmt, va_list args);
+
+int fmtCallbackv(fmtcallback_fn *callback, void *userdata, char *buffer, const char *fmt, va_list args);
@@ -23,7 +23,7 @@
 
 static const TCHAR *https__get_method_str(http_method_e method);
 
-static http_header_t *http__parse_headers(arena_t *arena, instream_t *in) {
+static http_header_t *http__parse_headers(arena_t *arena, intern_t *intern, instream_t *in) {
     http_header_t *head = NULL;
     strview_t line = (strview_t){0};
 
@@ -36,6 +36,11 @@ static http_header_t *http__parse_headers(arena_t *arena, instream_t *in) {
 
             h->key   = strvSub(line, 0, pos);
             h->value = strvSub(line, pos + 2, SIZE_MAX);
+
+            if (intern) {
+                h->atom = internAdd(intern, h->key);
+                h->key = internGet(intern, h->atom);
+            }
             
             h->next = head;
             head = h;
@@ -83,6 +88,14 @@ int httpVerNumber(http_version_t ver) {
 }
 
 http_req_t httpParseReq(arena_t *arena, strview_t request) {
+    return httpParseReqIntern(arena, NULL, request);
+}
+
+http_res_t httpParseRes(arena_t *arena, strview_t response) {
+    return httpParseResIntern(arena, NULL, response);
+}
+
+http_req_t httpParseReqIntern(arena_t *arena, intern_t *intern, strview_t request) {
     http_req_t req = {0};
     instream_t in = istrInitLen(request.buf, request.len);
 
@@ -93,7 +106,7 @@ http_req_t httpParseReq(arena_t *arena, strview_t request) {
 
     istrSkip(&in, 1); // skip \n
 
-    req.headers = http__parse_headers(arena, &in);
+    req.headers = http__parse_headers(arena, intern, &in);
 
     req.body = strvTrim(istrGetViewLen(&in, SIZE_MAX));
 
@@ -116,7 +129,7 @@ http_req_t httpParseReq(arena_t *arena, strview_t request) {
     return req;
 }
 
-http_res_t httpParseRes(arena_t *arena, strview_t response) {
+http_res_t httpParseResIntern(arena_t *arena, intern_t *intern, strview_t response) {
     http_res_t res = {0};
     instream_t in = istrInitLen(response.buf, response.len);
 
@@ -134,7 +147,7 @@ http_res_t httpParseRes(arena_t *arena, strview_t response) {
     istrIgnore(&in, '\n');
     istrSkip(&in, 1); // skip \n
 
-    res.headers = http__parse_headers(arena, &in);
+    res.headers = http__parse_headers(arena, intern, &in);
 
     strview_t encoding = httpGetHeader(res.headers, strv("transfer-encoding"));
     if (!strvEquals(encoding, strv("chunked"))) {
@@ -228,6 +241,20 @@ strview_t httpGetHeader(http_header_t *headers, strview_t key) {
     return (strview_t){0};
 }
 
+strview_t httpGetHeaderAtom(http_header_t *headers, atom_t key) {
+    // headers that weren't interned have ATOM_NONE, it must not match them
+    if (key == ATOM_NONE) {
+        return (strview_t){0};
+    }
+
+    for (http_header_t *h = headers; h; h = h->next) {
+        if (h->atom == key) {
+            return h->value;
+        }
+    }
+    return (strview_t){0};
+}
+
 str_t httpMakeUrlSafe(arena_t *arena, strview_t string) {
     strview_t chars = strv(" !\"#$%%&'()*+,/:;=?@[]");
     usize final_len = string.len;
@@ -2,6 +2,7 @@
 
 #include "collatypes.h"
 #include "str.h"
+#include "intern.h"
 
 typedef struct arena_t arena_t;
 typedef uintptr_t socket_t;
@@ -26,6 +27,8 @@ int httpVerNumber(http_version_t ver);
 
 typedef struct http_header_t {
     strview_t key;
+    // only set when parsed with an intern table
+    atom_t atom;
     strview_t value;
     struct http_header_t *next;
 } http_header_t;
@@ -48,6 +51,10 @@ typedef struct {
 // strview_t request needs to be valid for http_req_t to be valid!
 http_req_t httpParseReq(arena_t *arena, strview_t request);
 http_res_t httpParseRes(arena_t *arena, strview_t response);
+// header keys are interned and their atom is set, so they can be looked up with httpGetHeaderAtom.
+// keys are interned as they are, so atoms are as case sensitive as httpGetHeader
+http_req_t httpParseReqIntern(arena_t *arena, intern_t *intern, strview_t request);
+http_res_t httpParseResIntern(arena_t *arena, intern_t *intern, strview_t response);
 
 str_t httpReqToStr(arena_t *arena, http_req_t *req);
 str_t httpResToStr(arena_t *arena, http_res_t *res);
@@ -55,6 +62,7 @@ str_t httpResToStr(arena_t *arena, http_res_t *res);
 bool httpHasHeader(http_header_t *headers, strview_t key);
 void httpSetHeader(http_header_t *headers, strview_t key, strview_t value);
 strview_t httpGetHeader(http_header_t *headers, strview_t key);
+strview_t httpGetHeaderAtom(http_header_t *headers, atom_t key);
 
 str_t httpMakeUrlSafe(arena_t *arena, strview_t string);
 str_t httpDecodeUrlSafe(arena_t *arena, strview_t string);
@@ -0,0 +1,469 @@
+#include "image.h"
+
+#include "warnings/colla_warn_beg.h"
+
+#include <string.h>
+
+#include "arena.h"
+
+#if defined(__AVX2__)
+#define IMG_AVX2 1
+#include <immintrin.h>
+#else
+#define IMG_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMG_SSE2 1
+#include <emmintrin.h>
+#else
+#define IMG_SSE2 0
+#endif
+
+static int img__half(int v) {
+    return v > 1 ? v / 2 : 1;
+}
+
+static int img__clamp(int v, int lo, int hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+int imgMipCount(int width, int height) {
+    int count = 1;
+    while (width > 1 || height > 1) {
+        width = img__half(width);
+        height = img__half(height);
+        count++;
+    }
+    return count;
+}
+
+usize imgMipChainSize(int width, int height, imgformat_e format) {
+    usize total = (usize)width * height * format;
+    while (width > 1 || height > 1) {
+        width = img__half(width);
+        height = img__half(height);
+        total += (usize)width * height * format;
+    }
+    return total;
+}
+
+// == BOX FILTER =======================================================================================================
+
+#if IMG_SSE2
+
+// vertical sums of 8 bytes of two rows, widened to 16 bits
+static __m128i img__sse2_vsum(__m128i r0, __m128i r1, bool high) {
+    __m128i zero = _mm_setzero_si128();
+    return high ?
+        _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero)) :
+        _mm_add_epi16(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero));
+}
+
+// adds horizontally adjacent pixels of 16 input bytes, returns 8 sums
+static __m128i img__sse2_hsum(__m128i lo, __m128i hi, int bpp) {
+    switch (bpp) {
+        case IMG_R8:
+        {
+            __m128i ones = _mm_set1_epi16(1);
+            return _mm_packs_epi32(_mm_madd_epi16(lo, ones), _mm_madd_epi16(hi, ones));
+        }
+        case IMG_RG8:
+        {
+            // every pixel is 32 bits wide, move even and odd pixels to the bottom half
+            __m128i sum_lo = _mm_add_epi16(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 0, 3, 1)));
+            __m128i sum_hi = _mm_add_epi16(_mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 0, 3, 1)));
+            return _mm_unpacklo_epi64(sum_lo, sum_hi);
+        }
+        default:
+            // every pixel is 64 bits wide
+            return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+    }
+}
+
+// returns the number of output bytes written
+static usize img__box_row_sse2(const uint8 *r0, const uint8 *r1, uint8 *dst, usize out_bytes, int bpp) {
+    __m128i round = _mm_set1_epi16(2);
+    usize x = 0;
+
+    for (; x + 8 <= out_bytes; x += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(r0 + x * 2));
+        __m128i b = _mm_loadu_si128((const __m128i *)(r1 + x * 2));
+
+        __m128i sum = img__sse2_hsum(img__sse2_vsum(a, b, false), img__sse2_vsum(a, b, true), bpp);
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(sum, sum));
+    }
+
+    return x;
+}
+
+#endif
+
+#if IMG_AVX2
+
+// same as the sse2 version, every 128 bit lane works on its own 16 input bytes
+static usize img__box_row_avx2(const uint8 *r0, const uint8 *r1, uint8 *dst, usize out_bytes, int bpp) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i round = _mm256_set1_epi16(2);
+    usize x = 0;
+
+    for (; x + 16 <= out_bytes; x += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(r0 + x * 2));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(r1 + x * 2));
+
+        __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+        __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+
+        __m256i sum;
+        switch (bpp) {
+            case IMG_R8:
+            {
+                __m256i ones = _mm256_set1_epi16(1);
+                sum = _mm256_packs_epi32(_mm256_madd_epi16(lo, ones), _mm256_madd_epi16(hi, ones));
+                break;
+            }
+            case IMG_RG8:
+            {
+                __m256i sum_lo = _mm256_add_epi16(_mm256_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0)), _mm256_shuffle_epi32(lo, _MM_SHUFFLE(2, 0, 3, 1)));
+                __m256i sum_hi = _mm256_add_epi16(_mm256_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0)), _mm256_shuffle_epi32(hi, _MM_SHUFFLE(2, 0, 3, 1)));
+                sum = _mm256_unpacklo_epi64(sum_lo, sum_hi);
+                break;
+            }
+            default:
+                sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+                break;
+        }
+
+        sum = _mm256_srli_epi16(_mm256_add_epi16(sum, round), 2);
+
+        // the pack works per lane, gather the two low halves together
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm256_castsi256_si128(packed));
+    }
+
+    return x;
+}
+
+#endif
+
+static void img__box_row(const uint8 *r0, const uint8 *r1, uint8 *dst, int width, int bpp) {
+    int dst_width = img__half(width);
+    // only pixels with both horizontal neighbours inside the row can use the simd path
+    usize simd_bytes = (usize)(width / 2) * bpp;
+    usize x = 0;
+
+#if IMG_AVX2
+    x = img__box_row_avx2(r0, r1, dst, simd_bytes, bpp);
+#endif
+#if IMG_SSE2
+    x += img__box_row_sse2(r0 + x * 2, r1 + x * 2, dst + x, simd_bytes - x, bpp);
+#endif
+
+    for (int ox = (int)(x / bpp); ox < dst_width; ++ox) {
+        int x0 = ox * 2;
+        int x1 = img__clamp(x0 + 1, 0, width - 1);
+        for (int c = 0; c < bpp; ++c) {
+            uint32 sum = r0[x0 * bpp + c] + r0[x1 * bpp + c] + r1[x0 * bpp + c] + r1[x1 * bpp + c];
+            dst[ox * bpp + c] = (uint8)((sum + 2) >> 2);
+        }
+    }
+}
+
+static void img__box(const uint8 *src, int width, int height, uint8 *dst, int bpp) {
+    int dst_width = img__half(width);
+    int dst_height = img__half(height);
+    usize src_stride = (usize)width * bpp;
+    usize dst_stride = (usize)dst_width * bpp;
+
+    for (int oy = 0; oy < dst_height; ++oy) {
+        int y0 = oy * 2;
+        int y1 = img__clamp(y0 + 1, 0, height - 1);
+        img__box_row(src + y0 * src_stride, src + y1 * src_stride, dst + oy * dst_stride, width, bpp);
+    }
+}
+
+// == 8-TAP FILTERS ===================================================================================================
+
+// both are sampled at the 8 source texels around every output texel, in 1/256ths
+// catmull-rom
+static const int16 img__cubic_weights[8]  = { -3, -9, 29, 111, 111, 29, -9, -3 };
+// sinc windowed by a kaiser window with beta 4, 2 output texels wide
+static const int16 img__kaiser_weights[8] = { -3, -11, 30, 112, 112, 30, -11, -3 };
+
+// the horizontal pass is stored in 16 bits, it doesn't fit without dropping 2 bits,
+// the vertical pass drops the rest. the scalar and simd paths round the same way
+#define IMG_FILTER_H_SHIFT 2
+#define IMG_FILTER_V_SHIFT (16 - IMG_FILTER_H_SHIFT)
+
+#if IMG_SSE2
+
+// puts the same channel of the two pixels of every pair next to each other, so madd can weight them
+static __m128i img__sse2_pairs(__m128i v, int bpp) {
+    switch (bpp) {
+        case IMG_R8:
+            return v;
+        case IMG_RG8:
+            return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+        default:
+            return _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+    }
+}
+
+// weights of taps k * 2 and k * 2 + 1 in every 32 bit lane, in the order madd expects them
+static __m128i img__sse2_pair_weights(const int16 *weights, int k) {
+    return _mm_set1_epi32((int)((uint32)(uint16)weights[k * 2] | (uint32)(uint16)weights[k * 2 + 1] << 16));
+}
+
+// filters output bytes from x to end, every one of them needs all of its taps inside the row.
+// returns the first output byte that wasn't written
+static usize img__filter_h_sse2(const uint8 *row, int16 *out, usize x, usize end, int bpp, const int16 *weights) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi32(1 << (IMG_FILTER_H_SHIFT - 1));
+    __m128i pair_weights[4];
+    for (int k = 0; k < 4; ++k) {
+        pair_weights[k] = img__sse2_pair_weights(weights, k);
+    }
+
+    for (; x + 8 <= end; x += 8) {
+        // first tap of the first output pixel
+        const uint8 *base = row + (x * 2 - 3 * bpp);
+        __m128i sum_lo = round;
+        __m128i sum_hi = round;
+
+        // every load starts one pixel pair further, so it holds the pair of taps k * 2, k * 2 + 1 of every output
+        for (int k = 0; k < 4; ++k) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(base + k * 2 * bpp));
+            sum_lo = _mm_add_epi32(sum_lo, _mm_madd_epi16(img__sse2_pairs(_mm_unpacklo_epi8(v, zero), bpp), pair_weights[k]));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_madd_epi16(img__sse2_pairs(_mm_unpackhi_epi8(v, zero), bpp), pair_weights[k]));
+        }
+
+        sum_lo = _mm_srai_epi32(sum_lo, IMG_FILTER_H_SHIFT);
+        sum_hi = _mm_srai_epi32(sum_hi, IMG_FILTER_H_SHIFT);
+        _mm_storeu_si128((__m128i *)(out + x), _mm_packs_epi32(sum_lo, sum_hi));
+    }
+
+    return x;
+}
+
+// rows are the 8 rows of the horizontal pass under the output row
+static usize img__filter_v_sse2(const int16 **rows, uint8 *dst, usize x, usize end, const int16 *weights) {
+    __m128i round = _mm_set1_epi32(1 << (IMG_FILTER_V_SHIFT - 1));
+    __m128i pair_weights[4];
+    for (int k = 0; k < 4; ++k) {
+        pair_weights[k] = img__sse2_pair_weights(weights, k);
+    }
+
+    for (; x + 8 <= end; x += 8) {
+        __m128i sum_lo = round;
+        __m128i sum_hi = round;
+
+        for (int k = 0; k < 4; ++k) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k * 2] + x));
+            __m128i b = _mm_loadu_si128((const __m128i *)(rows[k * 2 + 1] + x));
+            sum_lo = _mm_add_epi32(sum_lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), pair_weights[k]));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), pair_weights[k]));
+        }
+
+        __m128i sum = _mm_packs_epi32(_mm_srai_epi32(sum_lo, IMG_FILTER_V_SHIFT), _mm_srai_epi32(sum_hi, IMG_FILTER_V_SHIFT));
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(sum, sum));
+    }
+
+    return x;
+}
+
+#endif
+
+#if IMG_AVX2
+
+// same as the sse2 versions, every 128 bit lane works on its own 16 input bytes
+static __m256i img__avx2_pairs(__m256i v, int bpp) {
+    switch (bpp) {
+        case IMG_R8:
+            return v;
+        case IMG_RG8:
+            return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+        default:
+            return _mm256_unpacklo_epi16(v, _mm256_srli_si256(v, 8));
+    }
+}
+
+static __m256i img__avx2_pair_weights(const int16 *weights, int k) {
+    return _mm256_set1_epi32((int)((uint32)(uint16)weights[k * 2] | (uint32)(uint16)weights[k * 2 + 1] << 16));
+}
+
+static usize img__filter_h_avx2(const uint8 *row, int16 *out, usize x, usize end, int bpp, const int16 *weights) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i round = _mm256_set1_epi32(1 << (IMG_FILTER_H_SHIFT - 1));
+    __m256i pair_weights[4];
+    for (int k = 0; k < 4; ++k) {
+        pair_weights[k] = img__avx2_pair_weights(weights, k);
+    }
+
+    for (; x + 16 <= end; x += 16) {
+        const uint8 *base = row + (x * 2 - 3 * bpp);
+        __m256i sum_lo = round;
+        __m256i sum_hi = round;
+
+        for (int k = 0; k < 4; ++k) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(base + k * 2 * bpp));
+            sum_lo = _mm256_add_epi32(sum_lo, _mm256_madd_epi16(img__avx2_pairs(_mm256_unpacklo_epi8(v, zero), bpp), pair_weights[k]));
+            sum_hi = _mm256_add_epi32(sum_hi, _mm256_madd_epi16(img__avx2_pairs(_mm256_unpackhi_epi8(v, zero), bpp), pair_weights[k]));
+        }
+
+        // low and high halves of each lane go back in order, no permute needed
+        sum_lo = _mm256_srai_epi32(sum_lo, IMG_FILTER_H_SHIFT);
+        sum_hi = _mm256_srai_epi32(sum_hi, IMG_FILTER_H_SHIFT);
+        _mm256_storeu_si256((__m256i *)(out + x), _mm256_packs_epi32(sum_lo, sum_hi));
+    }
+
+    return x;
+}
+
+static usize img__filter_v_avx2(const int16 **rows, uint8 *dst, usize x, usize end, const int16 *weights) {
+    __m256i round = _mm256_set1_epi32(1 << (IMG_FILTER_V_SHIFT - 1));
+    __m256i pair_weights[4];
+    for (int k = 0; k < 4; ++k) {
+        pair_weights[k] = img__avx2_pair_weights(weights, k);
+    }
+
+    for (; x + 16 <= end; x += 16) {
+        __m256i sum_lo = round;
+        __m256i sum_hi = round;
+
+        for (int k = 0; k < 4; ++k) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(rows[k * 2] + x));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(rows[k * 2 + 1] + x));
+            sum_lo = _mm256_add_epi32(sum_lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), pair_weights[k]));
+            sum_hi = _mm256_add_epi32(sum_hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), pair_weights[k]));
+        }
+
+        __m256i sum = _mm256_packs_epi32(_mm256_srai_epi32(sum_lo, IMG_FILTER_V_SHIFT), _mm256_srai_epi32(sum_hi, IMG_FILTER_V_SHIFT));
+        // the pack works per lane, gather the two low halves together
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm256_castsi256_si128(packed));
+    }
+
+    return x;
+}
+
+#endif
+
+static void img__filter_h_scalar(const uint8 *row, int16 *out, int from, int to, int width, int bpp, const int16 *weights) {
+    for (int ox = from; ox < to; ++ox) {
+        for (int c = 0; c < bpp; ++c) {
+            int32 sum = 1 << (IMG_FILTER_H_SHIFT - 1);
+            for (int k = 0; k < 8; ++k) {
+                int sx = img__clamp(ox * 2 - 3 + k, 0, width - 1);
+                sum += weights[k] * row[sx * bpp + c];
+            }
+            out[ox * bpp + c] = (int16)(sum >> IMG_FILTER_H_SHIFT);
+        }
+    }
+}
+
+static void img__filter_h(const uint8 *row, int16 *out, int width, int bpp, const int16 *weights) {
+    int dst_width = img__half(width);
+    // only output pixels with all 8 taps inside the row can use the simd path
+    int first = dst_width < 2 ? dst_width : 2;
+    int last = (width - 5) / 2;
+    usize x = (usize)first * bpp;
+    usize simd_end = last >= first ? (usize)(last + 1) * bpp : x;
+
+    img__filter_h_scalar(row, out, 0, first, width, bpp, weights);
+
+#if IMG_AVX2
+    x = img__filter_h_avx2(row, out, x, simd_end, bpp, weights);
+#endif
+#if IMG_SSE2
+    x = img__filter_h_sse2(row, out, x, simd_end, bpp, weights);
+#endif
+
+    img__filter_h_scalar(row, out, (int)(x / bpp), dst_width, width, bpp, weights);
+}
+
+static void img__filter_v(const int16 **rows, uint8 *dst, usize count, const int16 *weights) {
+    usize x = 0;
+
+#if IMG_AVX2
+    x = img__filter_v_avx2(rows, dst, x, count, weights);
+#endif
+#if IMG_SSE2
+    x = img__filter_v_sse2(rows, dst, x, count, weights);
+#endif
+
+    for (; x < count; ++x) {
+        int32 sum = 1 << (IMG_FILTER_V_SHIFT - 1);
+        for (int k = 0; k < 8; ++k) {
+            sum += weights[k] * rows[k][x];
+        }
+        dst[x] = (uint8)img__clamp(sum >> IMG_FILTER_V_SHIFT, 0, 255);
+    }
+}
+
+static void img__filter8(arena_t scratch, const uint8 *src, int width, int height, uint8 *dst, int bpp, const int16 *weights) {
+    int dst_width = img__half(width);
+    int dst_height = img__half(height);
+    usize src_stride = (usize)width * bpp;
+    usize tmp_stride = (usize)dst_width * bpp;
+
+    // horizontal pass, keeps full vertical resolution
+    int16 *tmp = alloc(&scratch, int16, tmp_stride * height, ALLOC_NOZERO);
+
+    for (int y = 0; y < height; ++y) {
+        img__filter_h(src + y * src_stride, tmp + y * tmp_stride, width, bpp, weights);
+    }
+
+    // vertical pass
+    for (int oy = 0; oy < dst_height; ++oy) {
+        const int16 *rows[8];
+        for (int k = 0; k < 8; ++k) {
+            rows[k] = tmp + img__clamp(oy * 2 - 3 + k, 0, height - 1) * tmp_stride;
+        }
+        img__filter_v(rows, dst + oy * tmp_stride, tmp_stride, weights);
+    }
+}
+
+// == PUBLIC FUNCTIONS =================================================================================================
+
+void imgDownsample(arena_t scratch, const uint8 *src, int width, int height, uint8 *dst, imgformat_e format, imgfilter_e filter) {
+    if (!src || !dst || width <= 0 || height <= 0) {
+        return;
+    }
+
+    switch (filter) {
+        case IMG_FILTER_BOX:    img__box(src, width, height, dst, format); break;
+        case IMG_FILTER_CUBIC:  img__filter8(scratch, src, width, height, dst, format, img__cubic_weights); break;
+        case IMG_FILTER_KAISER: img__filter8(scratch, src, width, height, dst, format, img__kaiser_weights); break;
+    }
+}
+
+imgmips_t imgBuildMips(arena_t *arena, const uint8 *src, int width, int height, imgformat_e format, imgfilter_e filter) {
+    if (!src || width <= 0 || height <= 0) {
+        return (imgmips_t){0};
+    }
+
+    imgmips_t out = {
+        .count = imgMipCount(width, height),
+        .format = format,
+    };
+
+    out.levels = alloc(arena, imgmip_t, out.count);
+    out.levels[0] = (imgmip_t){ (uint8 *)src, width, height };
+
+    for (int i = 1; i < out.count; ++i) {
+        imgmip_t *prev = &out.levels[i - 1];
+        imgmip_t *mip = &out.levels[i];
+
+        mip->width = img__half(prev->width);
+        mip->height = img__half(prev->height);
+        mip->pixels = alloc(arena, uint8, (usize)mip->width * mip->height * format, ALLOC_NOZERO);
+
+        imgDownsample(*arena, prev->pixels, prev->width, prev->height, mip->pixels, format, filter);
+    }
+
+    return out;
+}
+
+#include "warnings/colla_warn_end.h"
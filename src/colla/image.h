@@ -0,0 +1,46 @@
+#pragma once
+
+#include "collatypes.h"
+
+typedef struct arena_t arena_t;
+
+// the value is the number of bytes per pixel
+typedef enum {
+    IMG_R8    = 1,
+    IMG_RG8   = 2,
+    IMG_RGBA8 = 4,
+} imgformat_e;
+
+typedef enum {
+    // 2x2 average, rounded to nearest
+    IMG_FILTER_BOX,
+    // 8x8 separable catmull-rom, sharper than box but can ring on hard edges
+    IMG_FILTER_CUBIC,
+    // 8x8 separable kaiser windowed sinc, a bit sharper than cubic and rings a bit more
+    IMG_FILTER_KAISER,
+} imgfilter_e;
+
+typedef struct {
+    uint8 *pixels;
+    int width;
+    int height;
+} imgmip_t;
+
+typedef struct {
+    imgmip_t *levels;
+    int count;
+    imgformat_e format;
+} imgmips_t;
+
+// number of levels in a full chain, including the base level
+int imgMipCount(int width, int height);
+// size in bytes of every level in a full chain, including the base level
+usize imgMipChainSize(int width, int height, imgformat_e format);
+
+// halves the image, each side is clamped to a minimum of 1 pixel
+// dst needs to hold max(1, width / 2) * max(1, height / 2) pixels
+void imgDownsample(arena_t scratch, const uint8 *src, int width, int height, uint8 *dst, imgformat_e format, imgfilter_e filter);
+
+// builds a full mip chain, the base level points to src and is not copied
+// the memory after the last level is used as scratch space
+imgmips_t imgBuildMips(arena_t *arena, const uint8 *src, int width, int height, imgformat_e format, imgfilter_e filter);
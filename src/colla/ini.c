@@ -33,6 +33,29 @@ bool iniIsValid(ini_t *ctx) {
     return ctx && !strvIsEmpty(ctx->text);
 }
 
+void iniFree(ini_t *ctx, const iniopts_t *options) {
+    if (!ctx || !options) {
+        return;
+    }
+
+    initable_t *table = ctx->tables;
+    while (table) {
+        initable_t *next_table = table->next;
+
+        inivalue_t *value = table->values;
+        while (value) {
+            inivalue_t *next_value = value->next;
+            poolFree(options->value_pool, value);
+            value = next_value;
+        }
+
+        poolFree(options->table_pool, table);
+        table = next_table;
+    }
+
+    ctx->tables = ctx->tail = NULL;
+}
+
 initable_t *iniGetTable(ini_t *ctx, strview_t name) {
     initable_t *t = ctx ? ctx->tables : NULL;
     while (t) {
@@ -153,6 +176,8 @@ static iniopts_t ini__get_options(const iniopts_t *options) {
         SETOPT(key_value_divider);
         SETOPT(merge_duplicate_keys);
         SETOPT(merge_duplicate_tables);
+        SETOPT(value_pool);
+        SETOPT(table_pool);
     }
 
 #undef SETOPT
@@ -183,7 +208,7 @@ static void ini__add_value(arena_t *arena, initable_t *table, instream_t *in, in
         newval->value = value;
     }
     else {
-        newval = alloc(arena, inivalue_t);
+        newval = opts->value_pool ? poolNew(opts->value_pool, inivalue_t) : alloc(arena, inivalue_t);
         newval->key = key;
         newval->value = value;
 
@@ -215,7 +240,8 @@ static void ini__add_table(arena_t *arena, ini_t *ctx, instream_t *in, iniopts_t
     }
 
     if (!table) {
-        table = alloc(arena, initable_t);
+        table = options->table_pool ? poolNew(options->table_pool, initable_t) : alloc(arena, initable_t);
+        table->name = name;
 
         if (!ctx->tables) {
             ctx->tables = table;
@@ -247,9 +273,9 @@ static void ini__add_table(arena_t *arena, ini_t *ctx, instream_t *in, iniopts_t
 static void ini__parse(arena_t *arena, ini_t *ini, const iniopts_t *options) {
     iniopts_t opts = ini__get_options(options);
 
-    initable_t *root = alloc(arena, initable_t);
+    initable_t *root = opts.table_pool ? poolNew(opts.table_pool, initable_t) : alloc(arena, initable_t);
     root->name = INI_ROOT;
-    ini->tables = root;
+    ini->tables = ini->tail = root;
 
     instream_t in = istrInitLen(ini->text.buf, ini->text.len);
 
@@ -5,6 +5,7 @@
 #include "file.h"
 
 typedef struct arena_t arena_t;
+typedef struct arena_pool_t arena_pool_t;
 
 typedef struct inivalue_t {
     strview_t key;
@@ -29,6 +30,8 @@ typedef struct {
     bool merge_duplicate_tables; // default false
     bool merge_duplicate_keys;   // default false
     char key_value_divider;      // default =
+    arena_pool_t *value_pool;    // default NULL, values are allocated from the arena
+    arena_pool_t *table_pool;    // default NULL, tables are allocated from the arena
 } iniopts_t;
 
 ini_t iniParse(arena_t *arena, strview_t filename, const iniopts_t *options);
@@ -36,6 +39,8 @@ ini_t iniParseFile(arena_t *arena, file_t file, const iniopts_t *options);
 ini_t iniParseStr(arena_t *arena, strview_t str, const iniopts_t *options);
 
 bool iniIsValid(ini_t *ctx);
+// gives tables and values back to the pools in options, if any
+void iniFree(ini_t *ctx, const iniopts_t *options);
 
 #define INI_ROOT strv("__ROOT__")
 
@@ -0,0 +1,174 @@
+#include "intern.h"
+
+#include "warnings/colla_warn_beg.h"
+
+#include <string.h>
+
+#include "arena.h"
+
+#define INTERN_MIN_CAPACITY 16
+
+static uint64 intern__read64(const char *p) {
+    uint64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64 intern__mix(uint64 h) {
+    // murmur3 finalizer
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64 intern__read_small(const char *p, usize len) {
+    // len < 8, a couple of overlapping loads instead of a byte loop
+    if (len >= 4) {
+        uint32 lo, hi;
+        memcpy(&lo, p, sizeof(lo));
+        memcpy(&hi, p + len - 4, sizeof(hi));
+        return ((uint64)hi << 32) | lo;
+    }
+    if (len > 0) {
+        return ((uint64)(uint8)p[0] << 16) | ((uint64)(uint8)p[len >> 1] << 8) | (uint8)p[len - 1];
+    }
+    return 0;
+}
+
+uint64 internHash(strview_t str) {
+    const uint64 k = 0x9e3779b97f4a7c15ull;
+    uint64 h = str.len * k;
+
+    if (str.len < 8) {
+        return intern__mix(h ^ intern__read_small(str.buf, str.len));
+    }
+
+    usize i = 0;
+    for (; i + 8 < str.len; i += 8) {
+        h = (h ^ intern__read64(str.buf + i)) * k;
+        h ^= h >> 29;
+    }
+
+    // the last 8 bytes, overlapping with the ones already hashed
+    h = (h ^ intern__read64(str.buf + str.len - 8)) * k;
+
+    return intern__mix(h);
+}
+
+static uint64 intern__slot(atom_t atom, uint64 hash) {
+    return (hash & 0xFFFFFFFF00000000ull) | atom;
+}
+
+static void intern__rehash(intern_t *ctx, uint32 slot_count) {
+    ctx->slots = alloc(ctx->arena, uint64, slot_count);
+    ctx->slots_mask = slot_count - 1;
+
+    for (uint32 i = 0; i < ctx->count; ++i) {
+        uint64 hash = ctx->entries[i].hash;
+        uint32 index = (uint32)hash & ctx->slots_mask;
+        while (ctx->slots[index]) {
+            index = (index + 1) & ctx->slots_mask;
+        }
+        ctx->slots[index] = intern__slot(i + 1, hash);
+    }
+}
+
+intern_t internInit(arena_t *arena, uint32 capacity) {
+    if (capacity < INTERN_MIN_CAPACITY) {
+        capacity = INTERN_MIN_CAPACITY;
+    }
+
+    uint32 slot_count = INTERN_MIN_CAPACITY;
+    // keep the load factor under 3/4
+    while (slot_count / 4 * 3 < capacity) {
+        slot_count *= 2;
+    }
+
+    intern_t ctx = {
+        .arena = arena,
+        .entries = alloc(arena, intern_entry_t, capacity),
+        .entries_cap = capacity,
+    };
+
+    intern__rehash(&ctx, slot_count);
+
+    return ctx;
+}
+
+// returns the slot the string is in, or the empty slot it would go into
+static uint32 intern__probe(intern_t *ctx, strview_t str, uint64 hash) {
+    uint64 hash_hi = hash & 0xFFFFFFFF00000000ull;
+    uint32 index = (uint32)hash & ctx->slots_mask;
+
+    for (;;) {
+        uint64 slot = ctx->slots[index];
+        if (!slot) {
+            return index;
+        }
+        if ((slot & 0xFFFFFFFF00000000ull) == hash_hi) {
+            const intern_entry_t *entry = &ctx->entries[(uint32)slot - 1];
+            if (entry->hash == hash && entry->str.len == str.len && memcmp(entry->str.buf, str.buf, str.len) == 0) {
+                return index;
+            }
+        }
+        index = (index + 1) & ctx->slots_mask;
+    }
+}
+
+atom_t internAdd(intern_t *ctx, strview_t str) {
+    if (!ctx->slots) return ATOM_NONE;
+
+    uint64 hash = internHash(str);
+    uint32 index = intern__probe(ctx, str, hash);
+    if (ctx->slots[index]) {
+        return (atom_t)ctx->slots[index];
+    }
+
+    if (ctx->count == ctx->entries_cap) {
+        intern_entry_t *entries = alloc(ctx->arena, intern_entry_t, ctx->entries_cap * 2, ALLOC_NOZERO);
+        memcpy(entries, ctx->entries, sizeof(*entries) * ctx->count);
+        ctx->entries = entries;
+        ctx->entries_cap *= 2;
+    }
+
+    str_t copy = strInitView(ctx->arena, str);
+    ctx->entries[ctx->count] = (intern_entry_t){
+        .str = { copy.buf, copy.len },
+        .hash = hash,
+    };
+    atom_t atom = ++ctx->count;
+
+    if (ctx->count > (ctx->slots_mask + 1) / 4 * 3) {
+        intern__rehash(ctx, (ctx->slots_mask + 1) * 2);
+    }
+    else {
+        ctx->slots[index] = intern__slot(atom, hash);
+    }
+
+    return atom;
+}
+
+atom_t internFind(intern_t *ctx, strview_t str) {
+    if (!ctx->slots) return ATOM_NONE;
+    uint32 index = intern__probe(ctx, str, internHash(str));
+    return (atom_t)ctx->slots[index];
+}
+
+strview_t internGet(intern_t *ctx, atom_t atom) {
+    if (atom == ATOM_NONE || atom > ctx->count) {
+        return (strview_t){0};
+    }
+    return ctx->entries[atom - 1].str;
+}
+
+uint64 internGetHash(intern_t *ctx, atom_t atom) {
+    if (atom == ATOM_NONE || atom > ctx->count) {
+        return 0;
+    }
+    return ctx->entries[atom - 1].hash;
+}
+
+#include "warnings/colla_warn_end.h"
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "collatypes.h"
+#include "str.h"
+
+typedef struct arena_t arena_t;
+
+// 1 + index of the string in the table, 0 is never a valid atom
+typedef uint32 atom_t;
+
+#define ATOM_NONE 0
+
+typedef struct {
+    strview_t str;
+    uint64 hash;
+} intern_entry_t;
+
+// not thread safe, every string and the table itself live in arena
+// so it should live at least as long as the atoms are used
+typedef struct {
+    arena_t *arena;
+    // entries[atom - 1]
+    intern_entry_t *entries;
+    // open addressing, low 32 bits are the atom and high 32 bits part of the hash
+    uint64 *slots;
+    uint32 count;
+    uint32 entries_cap;
+    uint32 slots_mask;
+} intern_t;
+
+intern_t internInit(arena_t *arena, uint32 capacity);
+
+// returns the atom for str, adding a copy of it if it isn't in the table yet
+atom_t internAdd(intern_t *ctx, strview_t str);
+// returns ATOM_NONE if str was never added
+atom_t internFind(intern_t *ctx, strview_t str);
+
+// the canonical copy of the string, null terminated and valid as long as the arena is
+strview_t internGet(intern_t *ctx, atom_t atom);
+uint64 internGetHash(intern_t *ctx, atom_t atom);
+
+uint64 internHash(strview_t str);
@@ -3,19 +3,77 @@
 #include "warnings/colla_warn_beg.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
 
 #include "strstream.h"
 #include "file.h"
+#include "cthreads.h"
 #include "tracelog.h"
 
+#if COLLA_MSVC
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define JSON_AVX2 1
+#include <immintrin.h>
+#else
+#define JSON_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_SSE2 1
+#include <emmintrin.h>
+#else
+#define JSON_SSE2 0
+#endif
+
 #define json__ensure(c) \
     if (istrGet(in) != (c)) { \
         istrRewindN(in, 1); \
         fatal("wrong character at %zu, should be " #c " but is %c", istrTell(*in), istrPeek(in));\
     }
 
-jsonval_t *json__parse_pair(arena_t *arena, instream_t *in, jsonflags_e flags);
-jsonval_t *json__parse_value(arena_t *arena, instream_t *in, jsonflags_e flags);
+typedef struct {
+    arena_t *arena;
+    arena_pool_t *pool;
+    intern_t *intern;
+    jsonflags_e flags;
+    uint32 index_min_keys;
+} json__ctx_t;
+
+typedef struct {
+    // high 32 bits of the key hash, checked before comparing the key
+    uint32 hash;
+    jsonval_t *node;
+} json__slot_t;
+
+typedef struct jsonindex_t {
+    json__slot_t *slots;
+    uint32 mask;
+} jsonindex_t;
+
+static void json__maybe_index(json__ctx_t *ctx, jsonval_t *object) {
+    if (!ctx->index_min_keys) {
+        return;
+    }
+    uint32 count = 0;
+    for (jsonval_t *child = object->object; child && count < ctx->index_min_keys; child = child->next) {
+        count++;
+    }
+    if (count >= ctx->index_min_keys) {
+        jsonIndex(ctx->arena, object);
+    }
+}
+
+jsonval_t *json__parse_pair(json__ctx_t *ctx, instream_t *in);
+jsonval_t *json__parse_value(json__ctx_t *ctx, instream_t *in);
+
+jsonval_t *json__new_node(json__ctx_t *ctx) {
+    return ctx->pool ? poolNew(ctx->pool, jsonval_t) : alloc(ctx->arena, jsonval_t);
+}
 
 bool json__is_value_finished(instream_t *in) {
     usize old_pos = istrTell(*in);
@@ -44,7 +102,7 @@ void json__parse_null(instream_t *in) {
     }
 }
 
-jsonval_t *json__parse_array(arena_t *arena, instream_t *in, jsonflags_e flags) {
+jsonval_t *json__parse_array(json__ctx_t *ctx, instream_t *in) {
     json__ensure('[');
 
     istrSkipWhitespace(in);
@@ -55,7 +113,7 @@ jsonval_t *json__parse_array(arena_t *arena, instream_t *in, jsonflags_e flags)
         return NULL;
     }
     
-    jsonval_t *head = json__parse_value(arena, in, flags);
+    jsonval_t *head = json__parse_value(ctx, in);
     jsonval_t *cur = head;
     
     while (true) {
@@ -68,7 +126,7 @@ jsonval_t *json__parse_array(arena_t *arena, instream_t *in, jsonflags_e flags)
                 istrSkipWhitespace(in);
                 // trailing comma
                 if (istrPeek(in) == ']') {
-                    if (flags & JSON_NO_TRAILING_COMMAS) {
+                    if (ctx->flags & JSON_NO_TRAILING_COMMAS) {
                         fatal("trailing comma in array at at %zu: (%c)(%d)", istrTell(*in), *in->cur, *in->cur);
                     }
                     else {
@@ -76,7 +134,7 @@ jsonval_t *json__parse_array(arena_t *arena, instream_t *in, jsonflags_e flags)
                     }
                 }
 
-                jsonval_t *next = json__parse_value(arena, in, flags);
+                jsonval_t *next = json__parse_value(ctx, in);
                 cur->next = next;
                 next->prev = cur;
                 cur = next;
@@ -91,7 +149,7 @@ jsonval_t *json__parse_array(arena_t *arena, instream_t *in, jsonflags_e flags)
     return NULL;
 }
 
-str_t json__parse_string(arena_t *arena, instream_t *in) {
+strview_t json__parse_string_view(instream_t *in) {
     istrSkipWhitespace(in);
 
     json__ensure('"');
@@ -104,15 +162,18 @@ str_t json__parse_string(arena_t *arena, instream_t *in) {
         }
     }
     
-    usize len = in->cur - from;
-
-    str_t out = str(arena, from, len);
+    strview_t out = { from, in->cur - from };
 
     json__ensure('"');
 
     return out;
 }
 
+str_t json__parse_string(arena_t *arena, instream_t *in) {
+    strview_t view = json__parse_string_view(in);
+    return str(arena, view);
+}
+
 double json__parse_number(instream_t *in) {
     double value = 0.0;
     istrGetDouble(in, &value);
@@ -133,7 +194,7 @@ bool json__parse_bool(instream_t *in) {
     return false;
 }
 
-jsonval_t *json__parse_obj(arena_t *arena, instream_t *in, jsonflags_e flags) {
+jsonval_t *json__parse_obj(json__ctx_t *ctx, instream_t *in) {
     json__ensure('{');
 
     istrSkipWhitespace(in);
@@ -144,7 +205,7 @@ jsonval_t *json__parse_obj(arena_t *arena, instream_t *in, jsonflags_e flags) {
         return NULL;
     }
 
-    jsonval_t *head = json__parse_pair(arena, in, flags);
+    jsonval_t *head = json__parse_pair(ctx, in);
     jsonval_t *cur = head;
 
     while (true) {
@@ -156,11 +217,11 @@ jsonval_t *json__parse_obj(arena_t *arena, instream_t *in, jsonflags_e flags) {
             {
                 istrSkipWhitespace(in);
                 // trailing commas
-                if (!(flags & JSON_NO_TRAILING_COMMAS) && istrPeek(in) == '}') {
+                if (!(ctx->flags & JSON_NO_TRAILING_COMMAS) && istrPeek(in) == '}') {
                     return head;
                 }
 
-                jsonval_t *next = json__parse_pair(arena, in, flags);
+                jsonval_t *next = json__parse_pair(ctx, in);
                 cur->next = next;
                 next->prev = cur;
                 cur = next;
@@ -175,37 +236,45 @@ jsonval_t *json__parse_obj(arena_t *arena, instream_t *in, jsonflags_e flags) {
     return head;
 }
 
-jsonval_t *json__parse_pair(arena_t *arena, instream_t *in, jsonflags_e flags) {
-    str_t key = json__parse_string(arena, in);
+jsonval_t *json__parse_pair(json__ctx_t *ctx, instream_t *in) {
+    strview_t key = json__parse_string_view(in);
 
     // skip preamble
     istrSkipWhitespace(in);
     json__ensure(':');
 
-    jsonval_t *out = json__parse_value(arena, in, flags);
-    out->key = key;
+    jsonval_t *out = json__parse_value(ctx, in);
+    if (ctx->intern) {
+        out->key_atom = internAdd(ctx->intern, key);
+        strview_t canonical = internGet(ctx->intern, out->key_atom);
+        out->key = (str_t){ (char *)canonical.buf, canonical.len };
+    }
+    else {
+        out->key = str(ctx->arena, key);
+    }
     return out;
 }
 
-jsonval_t *json__parse_value(arena_t *arena, instream_t *in, jsonflags_e flags) {
-    jsonval_t *out = alloc(arena, jsonval_t);
+jsonval_t *json__parse_value(json__ctx_t *ctx, instream_t *in) {
+    jsonval_t *out = json__new_node(ctx);
 
     istrSkipWhitespace(in);
 
     switch (istrPeek(in)) {
         // object
         case '{':
-            out->object = json__parse_obj(arena, in, flags);
+            out->object = json__parse_obj(ctx, in);
             out->type = JSON_OBJECT;
+            json__maybe_index(ctx, out);
             break;
         // array
         case '[':
-            out->array = json__parse_array(arena, in, flags);
+            out->array = json__parse_array(ctx, in);
             out->type = JSON_ARRAY;
             break;
         // string
         case '"':
-            out->string = json__parse_string(arena, in);
+            out->string = json__parse_string(ctx->arena, in);
             out->type = JSON_STRING;
             break;
         // boolean
@@ -240,33 +309,1685 @@ json_t jsonParse(arena_t *arena, arena_t scratch, strview_t filename, jsonflags_
 }
 
 json_t jsonParseStr(arena_t *arena, strview_t jsonstr, jsonflags_e flags) {
-    jsonval_t *root = alloc(arena, jsonval_t);
+    return jsonParseStrOpts(arena, jsonstr, &(jsonopts_t){ .flags = flags });
+}
+
+json_t jsonParseStrPool(arena_t *arena, arena_pool_t *pool, strview_t jsonstr, jsonflags_e flags) {
+    return jsonParseStrOpts(arena, jsonstr, &(jsonopts_t){ .flags = flags, .pool = pool });
+}
+
+json_t jsonParseStrOpts(arena_t *arena, strview_t jsonstr, const jsonopts_t *opts) {
+    json__ctx_t ctx = {
+        .arena = arena,
+        .pool = opts ? opts->pool : NULL,
+        .intern = opts ? opts->intern : NULL,
+        .flags = opts ? opts->flags : JSON_DEFAULT,
+        .index_min_keys = opts ? opts->index_min_keys : 0,
+    };
+
+    jsonval_t *root = json__new_node(&ctx);
     root->type = JSON_OBJECT;
     
     instream_t in = istrInitLen(jsonstr.buf, jsonstr.len);
-    root->object = json__parse_obj(arena, &in, flags);
+    root->object = json__parse_obj(&ctx, &in);
+    json__maybe_index(&ctx, root);
 
     return root;
 }
 
-jsonval_t *jsonGet(jsonval_t *node, strview_t key) {
-    if (!node) return NULL;
+void jsonFree(arena_pool_t *pool, json_t json) {
+    if (!pool || !json) {
+        return;
+    }
 
-    if (node->type != JSON_OBJECT) {
-        err("passed type is not an object");
+    if (json->type == JSON_OBJECT || json->type == JSON_ARRAY) {
+        jsonval_t *child = json->type == JSON_OBJECT ? json->object : json->array;
+        while (child) {
+            jsonval_t *next = child->next;
+            jsonFree(pool, child);
+            child = next;
+        }
+    }
+
+    poolFree(pool, json);
+}
+
+// == STRUCTURAL INDEX PARSER ======================================
+
+// two stages like simdjson: the first one classifies 64 bytes at a time and writes the offset of every
+// structural character ({}[]:, and quotes outside of strings) and of the first byte of every scalar.
+// the second one walks those offsets to build the tree, it never looks at the bytes in between.
+// the first stage runs a window at a time, so there is no index as big as the input
+
+#define JSON_BLOCK 64
+// offsets the first stage keeps ahead of the second one
+#define JSON_INDEX_WINDOW 2048
+
+typedef struct {
+    const char *buf;
+    usize len;
+
+    // == stage 1 ==
+    usize next_block;
+    // all ones if the last block ended inside a string
+    uint64 prev_in_string;
+    uint64 prev_odd_backslash;
+    uint64 prev_scalar;
+    uint32 indices[JSON_INDEX_WINDOW + JSON_BLOCK + 1];
+    uint32 count;
+    uint32 cur;
+    bool finished;
+
+    // == stage 2 ==
+    json__ctx_t *ctx;
+    jsonerr_t *error;
+    int depth;
+} json__fast_t;
+
+typedef struct {
+    uint64 quote;
+    uint64 backslash;
+    uint64 op;
+    uint64 space;
+} json__masks_t;
+
+static inline int json__ctz64(uint64 v) {
+#if COLLA_MSVC
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (int)index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+#if JSON_AVX2
+
+static json__masks_t json__classify(const uint8 *p) {
+    json__masks_t m = {0};
+    for (int i = 0; i < JSON_BLOCK; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')))
+        );
+        __m256i space = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')))
+        );
+        m.quote     |= (uint64)(uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << i;
+        m.backslash |= (uint64)(uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << i;
+        m.op        |= (uint64)(uint32)_mm256_movemask_epi8(op) << i;
+        m.space     |= (uint64)(uint32)_mm256_movemask_epi8(space) << i;
+    }
+    return m;
+}
+
+#elif JSON_SSE2
+
+static json__masks_t json__classify(const uint8 *p) {
+    json__masks_t m = {0};
+    for (int i = 0; i < JSON_BLOCK; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(',')), _mm_cmpeq_epi8(v, _mm_set1_epi8(':')))
+        );
+        __m128i space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')))
+        );
+        m.quote     |= (uint64)(uint16)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+        m.backslash |= (uint64)(uint16)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+        m.op        |= (uint64)(uint16)_mm_movemask_epi8(op) << i;
+        m.space     |= (uint64)(uint16)_mm_movemask_epi8(space) << i;
+    }
+    return m;
+}
+
+#else
+
+static json__masks_t json__classify(const uint8 *p) {
+    json__masks_t m = {0};
+    for (int i = 0; i < JSON_BLOCK; ++i) {
+        uint64 bit = 1ull << i;
+        switch (p[i]) {
+            case '"':  m.quote |= bit;     break;
+            case '\\': m.backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ',': case ':':
+                m.op |= bit;
+                break;
+            case ' ': case '\t': case '\n': case '\r':
+                m.space |= bit;
+                break;
+        }
+    }
+    return m;
+}
+
+#endif
+
+// bits set on every character that comes right after an odd number of backslashes
+static uint64 json__escaped(uint64 backslash, uint64 *prev_odd) {
+    const uint64 even_bits = 0x5555555555555555ull;
+    const uint64 odd_bits = ~even_bits;
+
+    uint64 start_edges = backslash & ~(backslash << 1);
+    uint64 even_start_mask = even_bits ^ *prev_odd;
+    uint64 even_starts = start_edges & even_start_mask;
+    uint64 odd_starts = start_edges & ~even_start_mask;
+    uint64 even_carries = backslash + even_starts;
+
+    uint64 odd_carries = backslash + odd_starts;
+    bool ends_odd = odd_carries < backslash;
+    odd_carries |= *prev_odd;
+    *prev_odd = ends_odd ? 1 : 0;
+
+    uint64 even_carry_ends = even_carries & ~backslash;
+    uint64 odd_carry_ends = odd_carries & ~backslash;
+    uint64 even_start_odd_end = even_carry_ends & odd_bits;
+    uint64 odd_start_even_end = odd_carry_ends & even_bits;
+    return even_start_odd_end | odd_start_even_end;
+}
+
+// bit i is the xor of bits 0..i, turns quote positions into "inside a string" ranges
+static uint64 json__prefix_xor(uint64 x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+static void json__stage1_block(json__fast_t *ctx, const uint8 *p, uint32 base) {
+    json__masks_t m = json__classify(p);
+
+    uint64 quote = m.quote & ~json__escaped(m.backslash, &ctx->prev_odd_backslash);
+    // includes the opening quote but not the closing one
+    uint64 in_string = json__prefix_xor(quote) ^ ctx->prev_in_string;
+    ctx->prev_in_string = (uint64)((int64)in_string >> 63);
+
+    // the first byte of every run of non-structural, non-whitespace characters
+    uint64 scalar = ~(m.op | m.space) & ~quote;
+    uint64 follows_scalar = (scalar << 1) | ctx->prev_scalar;
+    ctx->prev_scalar = scalar >> 63;
+
+    uint64 structurals = ((m.op | (scalar & ~follows_scalar)) & ~in_string) | quote;
+
+    uint32 *out = ctx->indices + ctx->count;
+    while (structurals) {
+        *out++ = base + json__ctz64(structurals);
+        structurals &= structurals - 1;
+    }
+    ctx->count = (uint32)(out - ctx->indices);
+}
+
+static void json__stage1_fill(json__fast_t *ctx) {
+    ctx->count = ctx->cur = 0;
+
+    while (ctx->count < JSON_INDEX_WINDOW && ctx->next_block < ctx->len) {
+        usize base = ctx->next_block;
+        if (ctx->len - base >= JSON_BLOCK) {
+            json__stage1_block(ctx, (const uint8 *)ctx->buf + base, (uint32)base);
+        }
+        else {
+            // the last block is padded with whitespace
+            uint8 tail[JSON_BLOCK];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, ctx->buf + base, ctx->len - base);
+            json__stage1_block(ctx, tail, (uint32)base);
+        }
+        ctx->next_block += JSON_BLOCK;
+    }
+
+    if (ctx->next_block >= ctx->len) {
+        // the end of the input is the last index, so running out is always noticed
+        ctx->indices[ctx->count++] = (uint32)ctx->len;
+        ctx->finished = true;
+    }
+}
+
+static uint32 json__fast_next(json__fast_t *ctx) {
+    if (ctx->cur == ctx->count) {
+        if (ctx->finished) {
+            return (uint32)ctx->len;
+        }
+        json__stage1_fill(ctx);
+    }
+    return ctx->indices[ctx->cur++];
+}
+
+static uint32 json__fast_peek(json__fast_t *ctx) {
+    if (ctx->cur == ctx->count) {
+        if (ctx->finished) {
+            return (uint32)ctx->len;
+        }
+        json__stage1_fill(ctx);
+    }
+    return ctx->indices[ctx->cur];
+}
+
+static bool json__fast_error(json__fast_t *ctx, usize offset, const char *message) {
+    if (ctx->error->message) {
+        return false;
+    }
+
+    usize line = 1, column = 1;
+    for (usize i = 0; i < offset && i < ctx->len; ++i) {
+        if (ctx->buf[i] == '\n') {
+            line++;
+            column = 1;
+        }
+        else {
+            column++;
+        }
+    }
+
+    *ctx->error = (jsonerr_t){
+        .message = message,
+        .offset = offset,
+        .line = line,
+        .column = column,
+    };
+
+    return false;
+}
+
+static char json__fast_char(json__fast_t *ctx, uint32 index) {
+    return index < ctx->len ? ctx->buf[index] : '\0';
+}
+
+static bool json__fast_value(json__fast_t *ctx, uint32 index, jsonval_t *out);
+
+// index points to the opening quote, the closing one is always the next structural
+static bool json__fast_string(json__fast_t *ctx, uint32 index, strview_t *out) {
+    uint32 end = json__fast_next(ctx);
+    if (end >= ctx->len) {
+        return json__fast_error(ctx, index, "unterminated string");
+    }
+    *out = (strview_t){ ctx->buf + index + 1, end - index - 1 };
+    return true;
+}
+
+static bool json__is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool json__is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool json__is_number(strview_t v) {
+    usize i = 0;
+    if (i < v.len && v.buf[i] == '-') i++;
+    if (i < v.len && v.buf[i] == '0') {
+        i++;
+    }
+    else {
+        if (i == v.len || !json__is_digit(v.buf[i])) return false;
+        while (i < v.len && json__is_digit(v.buf[i])) i++;
+    }
+    if (i < v.len && v.buf[i] == '.') {
+        i++;
+        if (i == v.len || !json__is_digit(v.buf[i])) return false;
+        while (i < v.len && json__is_digit(v.buf[i])) i++;
+    }
+    if (i < v.len && (v.buf[i] == 'e' || v.buf[i] == 'E')) {
+        i++;
+        if (i < v.len && (v.buf[i] == '+' || v.buf[i] == '-')) i++;
+        if (i == v.len || !json__is_digit(v.buf[i])) return false;
+        while (i < v.len && json__is_digit(v.buf[i])) i++;
+    }
+    return i == v.len;
+}
+
+static bool json__fast_scalar(json__fast_t *ctx, uint32 index, jsonval_t *out) {
+    // the scalar goes on until the next structural, minus the whitespace before it
+    usize end = json__fast_peek(ctx);
+    while (end > index && json__is_space(ctx->buf[end - 1])) {
+        end--;
+    }
+    strview_t scalar = { ctx->buf + index, end - index };
+
+    switch (scalar.buf[0]) {
+        case 't':
+            out->type = JSON_BOOL;
+            out->boolean = true;
+            return strvEquals(scalar, strv("true")) || json__fast_error(ctx, index, "invalid literal, expected true");
+        case 'f':
+            out->type = JSON_BOOL;
+            out->boolean = false;
+            return strvEquals(scalar, strv("false")) || json__fast_error(ctx, index, "invalid literal, expected false");
+        case 'n':
+            out->type = JSON_NULL;
+            return strvEquals(scalar, strv("null")) || json__fast_error(ctx, index, "invalid literal, expected null");
+        case '/':
+            return json__fast_error(ctx, index, "comments are not supported");
+    }
+
+    if (!json__is_number(scalar)) {
+        return json__fast_error(ctx, index, "invalid number");
+    }
+
+    instream_t in = istrInitLen(scalar.buf, scalar.len);
+    out->type = JSON_NUMBER;
+    if (!istrGetDouble(&in, &out->number) || !istrIsFinished(in)) {
+        return json__fast_error(ctx, index, "invalid number");
+    }
+    return true;
+}
+
+static bool json__fast_object(json__fast_t *ctx, uint32 open, jsonval_t **head) {
+    jsonval_t *tail = NULL;
+    uint32 index = json__fast_next(ctx);
+
+    if (json__fast_char(ctx, index) == '}') {
+        return true;
+    }
+
+    for (;;) {
+        if (json__fast_char(ctx, index) != '"') {
+            return json__fast_error(ctx, index, index < ctx->len ? "expected a key" : "unterminated object");
+        }
+
+        strview_t key = {0};
+        if (!json__fast_string(ctx, index, &key)) return false;
+
+        index = json__fast_next(ctx);
+        if (json__fast_char(ctx, index) != ':') {
+            return json__fast_error(ctx, index, "expected ':' after key");
+        }
+
+        jsonval_t *val = json__new_node(ctx->ctx);
+        if (!json__fast_value(ctx, json__fast_next(ctx), val)) return false;
+
+        if (ctx->ctx->intern) {
+            val->key_atom = internAdd(ctx->ctx->intern, key);
+            strview_t canonical = internGet(ctx->ctx->intern, val->key_atom);
+            val->key = (str_t){ (char *)canonical.buf, canonical.len };
+        }
+        else {
+            val->key = str(ctx->ctx->arena, key);
+        }
+
+        if (tail) {
+            tail->next = val;
+            val->prev = tail;
+        }
+        else {
+            *head = val;
+        }
+        tail = val;
+
+        index = json__fast_next(ctx);
+        switch (json__fast_char(ctx, index)) {
+            case '}':
+                return true;
+            case ',':
+                index = json__fast_next(ctx);
+                if (json__fast_char(ctx, index) == '}') {
+                    if (ctx->ctx->flags & JSON_NO_TRAILING_COMMAS) {
+                        return json__fast_error(ctx, index, "trailing comma in object");
+                    }
+                    return true;
+                }
+                break;
+            default:
+                return json__fast_error(ctx, index < ctx->len ? index : open, index < ctx->len ? "expected ',' or '}'" : "unterminated object");
+        }
+    }
+}
+
+static bool json__fast_array(json__fast_t *ctx, uint32 open, jsonval_t **head) {
+    jsonval_t *tail = NULL;
+    uint32 index = json__fast_next(ctx);
+
+    if (json__fast_char(ctx, index) == ']') {
+        return true;
+    }
+
+    for (;;) {
+        jsonval_t *val = json__new_node(ctx->ctx);
+        if (!json__fast_value(ctx, index, val)) return false;
+
+        if (tail) {
+            tail->next = val;
+            val->prev = tail;
+        }
+        else {
+            *head = val;
+        }
+        tail = val;
+
+        index = json__fast_next(ctx);
+        switch (json__fast_char(ctx, index)) {
+            case ']':
+                return true;
+            case ',':
+                index = json__fast_next(ctx);
+                if (json__fast_char(ctx, index) == ']') {
+                    if (ctx->ctx->flags & JSON_NO_TRAILING_COMMAS) {
+                        return json__fast_error(ctx, index, "trailing comma in array");
+                    }
+                    return true;
+                }
+                break;
+            default:
+                return json__fast_error(ctx, index < ctx->len ? index : open, index < ctx->len ? "expected ',' or ']'" : "unterminated array");
+        }
+    }
+}
+
+static bool json__fast_value(json__fast_t *ctx, uint32 index, jsonval_t *out) {
+    if (index >= ctx->len) {
+        return json__fast_error(ctx, ctx->len, "unexpected end of input, expected a value");
+    }
+
+    switch (ctx->buf[index]) {
+        case '{':
+        case '[':
+        {
+            if (++ctx->depth > JSON_MAX_DEPTH) {
+                return json__fast_error(ctx, index, "too much nesting");
+            }
+            bool is_object = ctx->buf[index] == '{';
+            out->type = is_object ? JSON_OBJECT : JSON_ARRAY;
+            bool ok = is_object ?
+                json__fast_object(ctx, index, &out->object) :
+                json__fast_array(ctx, index, &out->array);
+            ctx->depth--;
+            if (ok && is_object) {
+                json__maybe_index(ctx->ctx, out);
+            }
+            return ok;
+        }
+        case '"':
+        {
+            strview_t string = {0};
+            if (!json__fast_string(ctx, index, &string)) return false;
+            out->type = JSON_STRING;
+            out->string = str(ctx->ctx->arena, string);
+            return true;
+        }
+        case '}': case ']': case ',': case ':':
+            return json__fast_error(ctx, index, "expected a value");
+        default:
+            return json__fast_scalar(ctx, index, out);
+    }
+}
+
+json_t jsonParseStrFast(arena_t *arena, strview_t jsonstr, const jsonopts_t *opts, jsonerr_t *error) {
+    json__ctx_t ctx = {
+        .arena = arena,
+        .pool = opts ? opts->pool : NULL,
+        .intern = opts ? opts->intern : NULL,
+        .flags = opts ? opts->flags : JSON_DEFAULT,
+        .index_min_keys = opts ? opts->index_min_keys : 0,
+    };
+
+    jsonerr_t local_error = {0};
+    if (!error) error = &local_error;
+    *error = (jsonerr_t){0};
+
+    if (jsonstr.len >= UINT32_MAX) {
+        json__fast_error(&(json__fast_t){ .error = error }, 0, "input is bigger than 4GB");
+        err("json: %s", error->message);
         return NULL;
     }
 
-    node = node->object;
+    json__fast_t state = {
+        .buf = jsonstr.buf,
+        .len = jsonstr.len,
+        .ctx = &ctx,
+        .error = error,
+    };
+    json__fast_t *fast = &state;
+    json__stage1_fill(fast);
 
-    while (node) {
-        if (strvEquals(strv(node->key), key)) {
-            return node;
+    jsonval_t *root = json__new_node(&ctx);
+    bool ok = json__fast_value(fast, json__fast_next(fast), root);
+
+    // trailing content goes first: an unterminated string after the root is reported the same way
+    // whether or not the first stage has already reached it
+    if (ok) {
+        uint32 trailing = json__fast_next(fast);
+        if (trailing < jsonstr.len) {
+            ok = json__fast_error(fast, trailing, "unexpected content after the root value");
         }
-        node = node->next;
     }
+    if (ok && fast->prev_in_string) {
+        ok = json__fast_error(fast, jsonstr.len, "unterminated string");
+    }
+
+    if (!ok) {
+        if (error == &local_error) {
+            err("json: %s at %zu:%zu", error->message, error->line, error->column);
+        }
+        jsonFree(ctx.pool, root);
+        return NULL;
+    }
+
+    return root;
+}
+
+// == STREAMING PARSER =============================================
+
+// a push parser: every chunk is walked once and the events point straight into it, only strings and
+// scalars that are split between two chunks get copied to the token buffer
 
+// size of the blocks jsonSaxFile reads
+#define JSON_SAX_CHUNK KB(64)
+#define JSON_LINES_MAX_THREADS 64
+
+typedef enum {
+    JSON__SAX_VALUE,
+    // after '[', or after ',' when trailing commas are allowed
+    JSON__SAX_VALUE_OR_END,
+    JSON__SAX_KEY,
+    // after '{', or after ',' when trailing commas are allowed
+    JSON__SAX_KEY_OR_END,
+    JSON__SAX_COLON,
+    JSON__SAX_AFTER_VALUE,
+    JSON__SAX_ROOT_DONE,
+    // in the middle of a token that goes on in the next chunk
+    JSON__SAX_STRING,
+    JSON__SAX_SCALAR,
+    JSON__SAX_FAILED,
+} json__sax_state_e;
+
+typedef struct {
+    const char *text;
+    const char *error;
+} json__sax_literal_t;
+
+static const json__sax_literal_t json__sax_literals[] = {
+    { "true",  "invalid literal, expected true" },
+    { "false", "invalid literal, expected false" },
+    { "null",  "invalid literal, expected null" },
+};
+
+static usize json__sax_tell(jsonsax_t *ctx, const char *p) {
+    return ctx->offset + (usize)(p - ctx->chunk);
+}
+
+static jsonsax_pos_t json__sax_pos(jsonsax_t *ctx, usize offset) {
+    return (jsonsax_pos_t){
+        .offset = offset,
+        .line = ctx->line,
+        .column = offset - ctx->line_start + 1,
+    };
+}
+
+static const char *json__sax_error_at(jsonsax_t *ctx, jsonsax_pos_t pos, const char *message) {
+    ctx->error = (jsonerr_t){
+        .message = message,
+        .offset = pos.offset,
+        .line = pos.line,
+        .column = pos.column,
+    };
+    ctx->state = JSON__SAX_FAILED;
     return NULL;
 }
 
-#include "warnings/colla_warn_end.h"
\ No newline at end of file
+// offset must be on the current line
+static const char *json__sax_error(jsonsax_t *ctx, usize offset, const char *message) {
+    return json__sax_error_at(ctx, json__sax_pos(ctx, offset), message);
+}
+
+static void json__sax_newline(jsonsax_t *ctx, const char *p) {
+    ctx->line++;
+    ctx->line_start = json__sax_tell(ctx, p) + 1;
+}
+
+static bool json__sax_emit(jsonsax_t *ctx, usize offset, jsonevent_t event) {
+    if (ctx->callback && !ctx->callback(ctx->userdata, &event)) {
+        json__sax_error(ctx, offset, "stopped by the callback");
+        return false;
+    }
+    return true;
+}
+
+static void json__sax_append(jsonsax_t *ctx, const char *buf, usize len) {
+    if (ctx->token_len + len > ctx->token_cap) {
+        usize cap = ctx->token_cap ? ctx->token_cap * 2 : 256;
+        while (cap < ctx->token_len + len) {
+            cap *= 2;
+        }
+        char *token = alloc(ctx->arena, char, cap, ALLOC_NOZERO);
+        memcpy(token, ctx->token, ctx->token_len);
+        ctx->token = token;
+        ctx->token_cap = cap;
+    }
+    memcpy(ctx->token + ctx->token_len, buf, len);
+    ctx->token_len += len;
+}
+
+static bool json__sax_in_object(jsonsax_t *ctx) {
+    uint32 top = ctx->depth - 1;
+    return (ctx->stack[top / 64] >> (top % 64)) & 1;
+}
+
+static void json__sax_value_done(jsonsax_t *ctx) {
+    ctx->state = ctx->depth ? JSON__SAX_AFTER_VALUE : JSON__SAX_ROOT_DONE;
+}
+
+static const char *json__sax_begin(jsonsax_t *ctx, const char *p, bool object) {
+    usize offset = json__sax_tell(ctx, p);
+    if (ctx->depth == JSON_MAX_DEPTH) {
+        return json__sax_error(ctx, offset, "too much nesting");
+    }
+
+    jsonevent_t event = {
+        .type = object ? JSON_EVENT_OBJECT_BEGIN : JSON_EVENT_ARRAY_BEGIN,
+        .depth = ctx->depth,
+    };
+
+    if (ctx->depth == ctx->open_cap) {
+        uint32 cap = ctx->open_cap ? ctx->open_cap * 2 : 16;
+        jsonsax_pos_t *open = alloc(ctx->arena, jsonsax_pos_t, cap, ALLOC_NOZERO);
+        memcpy(open, ctx->open, sizeof(*open) * ctx->depth);
+        ctx->open = open;
+        ctx->open_cap = cap;
+    }
+    ctx->open[ctx->depth] = json__sax_pos(ctx, offset);
+
+    uint64 bit = 1ull << (ctx->depth % 64);
+    uint64 *word = &ctx->stack[ctx->depth / 64];
+    *word = object ? *word | bit : *word & ~bit;
+    ctx->depth++;
+    ctx->state = object ? JSON__SAX_KEY_OR_END : JSON__SAX_VALUE_OR_END;
+
+    return json__sax_emit(ctx, offset, event) ? p + 1 : NULL;
+}
+
+static const char *json__sax_end(jsonsax_t *ctx, const char *p, bool object) {
+    ctx->depth--;
+    json__sax_value_done(ctx);
+
+    jsonevent_t event = {
+        .type = object ? JSON_EVENT_OBJECT_END : JSON_EVENT_ARRAY_END,
+        .depth = ctx->depth,
+    };
+    return json__sax_emit(ctx, json__sax_tell(ctx, p), event) ? p + 1 : NULL;
+}
+
+// returns the closing quote, or end if the string goes on in the next chunk
+static const char *json__sax_scan_string(jsonsax_t *ctx, const char *p, const char *end) {
+    if (ctx->escape && p < end) {
+        ctx->escape = false;
+        if (*p == '\n') {
+            json__sax_newline(ctx, p);
+        }
+        p++;
+    }
+
+#if JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i newline = _mm_set1_epi8('\n');
+#endif
+
+    while (p < end) {
+#if JSON_SSE2
+        while (end - p >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)p);
+            __m128i hit = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                _mm_cmpeq_epi8(v, newline)
+            );
+            int mask = _mm_movemask_epi8(hit);
+            if (mask) {
+                p += json__ctz64((uint64)mask);
+                break;
+            }
+            p += 16;
+        }
+#endif
+        while (p < end && *p != '"' && *p != '\\' && *p != '\n') {
+            p++;
+        }
+
+        if (p == end) {
+            break;
+        }
+        if (*p == '"') {
+            return p;
+        }
+        if (*p == '\n') {
+            json__sax_newline(ctx, p++);
+            continue;
+        }
+
+        // skip the escaped character, which might be in the next chunk
+        if (++p == end) {
+            ctx->escape = true;
+            break;
+        }
+        if (*p == '\n') {
+            json__sax_newline(ctx, p);
+        }
+        p++;
+    }
+
+    return end;
+}
+
+// p is the first byte of the string, or where it goes on from the last chunk
+static const char *json__sax_string(jsonsax_t *ctx, const char *p, const char *end) {
+    const char *close = json__sax_scan_string(ctx, p, end);
+    if (close == end) {
+        json__sax_append(ctx, p, (usize)(end - p));
+        ctx->state = JSON__SAX_STRING;
+        return end;
+    }
+
+    strview_t value = { p, (usize)(close - p) };
+    usize offset = json__sax_tell(ctx, close) - value.len - 1;
+    if (ctx->state == JSON__SAX_STRING) {
+        json__sax_append(ctx, p, value.len);
+        value = (strview_t){ ctx->token, ctx->token_len };
+        offset = json__sax_tell(ctx, close) - value.len - 1;
+        ctx->token_len = 0;
+    }
+
+    jsonevent_t event = {
+        .type = ctx->is_key ? JSON_EVENT_KEY : JSON_EVENT_STRING,
+        .string = value,
+        .depth = ctx->depth,
+    };
+
+    if (ctx->is_key) {
+        ctx->state = JSON__SAX_COLON;
+    }
+    else {
+        json__sax_value_done(ctx);
+    }
+
+    return json__sax_emit(ctx, offset, event) ? close + 1 : NULL;
+}
+
+static bool json__sax_emit_scalar(jsonsax_t *ctx, usize offset, strview_t scalar) {
+    jsonevent_t event = {
+        .depth = ctx->depth,
+    };
+
+    switch (scalar.buf[0]) {
+        case 't': // fallthrough
+        case 'f': // fallthrough
+        case 'n':
+        {
+            const json__sax_literal_t *literal = &json__sax_literals[scalar.buf[0] == 't' ? 0 : scalar.buf[0] == 'f' ? 1 : 2];
+            if (!strvEquals(scalar, strv(literal->text))) {
+                json__sax_error(ctx, offset, literal->error);
+                return false;
+            }
+            event.type = scalar.buf[0] == 'n' ? JSON_EVENT_NULL : JSON_EVENT_BOOL;
+            event.boolean = scalar.buf[0] == 't';
+            break;
+        }
+        case '/':
+            json__sax_error(ctx, offset, "comments are not supported");
+            return false;
+        default:
+        {
+            instream_t in = istrInitLen(scalar.buf, scalar.len);
+            if (!json__is_number(scalar) || !istrGetDouble(&in, &event.number) || !istrIsFinished(in)) {
+                json__sax_error(ctx, offset, "invalid number");
+                return false;
+            }
+            event.type = JSON_EVENT_NUMBER;
+            break;
+        }
+    }
+
+    json__sax_value_done(ctx);
+    return json__sax_emit(ctx, offset, event);
+}
+
+static bool json__sax_is_scalar_char(char c) {
+    switch (c) {
+        case ' ': case '\t': case '\n': case '\r':
+        case '{': case '}': case '[': case ']': case ',': case ':': case '"':
+            return false;
+    }
+    return true;
+}
+
+// like in the fast parser, a scalar goes on until whitespace or a structural character and is checked
+// as a whole, so 1.5x is an invalid number rather than 1.5 followed by garbage. one at the end of a
+// chunk is always kept until the next one, as it might go on there
+static const char *json__sax_scalar(jsonsax_t *ctx, const char *p, const char *end) {
+    const char *start = p;
+    while (p < end && json__sax_is_scalar_char(*p)) {
+        p++;
+    }
+
+    if (p == end) {
+        json__sax_append(ctx, start, (usize)(end - start));
+        ctx->state = JSON__SAX_SCALAR;
+        return end;
+    }
+
+    strview_t scalar = { start, (usize)(p - start) };
+    if (ctx->state == JSON__SAX_SCALAR) {
+        json__sax_append(ctx, start, scalar.len);
+        scalar = (strview_t){ ctx->token, ctx->token_len };
+        ctx->token_len = 0;
+    }
+
+    return json__sax_emit_scalar(ctx, json__sax_tell(ctx, p) - scalar.len, scalar) ? p : NULL;
+}
+
+static const char *json__sax_value(jsonsax_t *ctx, const char *p, const char *end) {
+    switch (*p) {
+        case '{':
+            return json__sax_begin(ctx, p, true);
+        case '[':
+            return json__sax_begin(ctx, p, false);
+        case '"':
+            ctx->is_key = false;
+            ctx->string_start = json__sax_pos(ctx, json__sax_tell(ctx, p));
+            return json__sax_string(ctx, p + 1, end);
+        case ']':
+            if (ctx->depth && !json__sax_in_object(ctx)) {
+                return json__sax_error(ctx, json__sax_tell(ctx, p), "trailing comma in array");
+            }
+            // fallthrough
+        case '}': // fallthrough
+        case ',': // fallthrough
+        case ':':
+            return json__sax_error(ctx, json__sax_tell(ctx, p), "expected a value");
+    }
+
+    return json__sax_scalar(ctx, p, end);
+}
+
+static const char *json__sax_token(jsonsax_t *ctx, const char *p, const char *end) {
+    char c = *p;
+
+    switch (ctx->state) {
+        case JSON__SAX_VALUE_OR_END:
+            if (c == ']') {
+                return json__sax_end(ctx, p, false);
+            }
+            return json__sax_value(ctx, p, end);
+        case JSON__SAX_ROOT_DONE:
+            if (!(ctx->flags & JSON_MULTIPLE_ROOTS)) {
+                return json__sax_error(ctx, json__sax_tell(ctx, p), "unexpected content after the root value");
+            }
+            return json__sax_value(ctx, p, end);
+        case JSON__SAX_VALUE:
+            return json__sax_value(ctx, p, end);
+        case JSON__SAX_KEY_OR_END:
+            if (c == '}') {
+                return json__sax_end(ctx, p, true);
+            }
+            // fallthrough
+        case JSON__SAX_KEY:
+            if (c != '"') {
+                return json__sax_error(ctx, json__sax_tell(ctx, p), c == '}' ? "trailing comma in object" : "expected a key");
+            }
+            ctx->is_key = true;
+            ctx->string_start = json__sax_pos(ctx, json__sax_tell(ctx, p));
+            return json__sax_string(ctx, p + 1, end);
+        case JSON__SAX_COLON:
+            if (c != ':') {
+                return json__sax_error(ctx, json__sax_tell(ctx, p), "expected ':' after key");
+            }
+            ctx->state = JSON__SAX_VALUE;
+            return p + 1;
+        case JSON__SAX_AFTER_VALUE:
+        {
+            bool object = json__sax_in_object(ctx);
+            bool trailing = !(ctx->flags & JSON_NO_TRAILING_COMMAS);
+            if (c == ',') {
+                ctx->state = object ?
+                    (trailing ? JSON__SAX_KEY_OR_END : JSON__SAX_KEY) :
+                    (trailing ? JSON__SAX_VALUE_OR_END : JSON__SAX_VALUE);
+                return p + 1;
+            }
+            if (c == (object ? '}' : ']')) {
+                return json__sax_end(ctx, p, object);
+            }
+            return json__sax_error(ctx, json__sax_tell(ctx, p), object ? "expected ',' or '}'" : "expected ',' or ']'");
+        }
+    }
+
+    return NULL;
+}
+
+jsonsax_t jsonSaxInit(arena_t *arena, jsonflags_e flags, jsonsax_fn *callback, void *userdata) {
+    return (jsonsax_t){
+        .callback = callback,
+        .userdata = userdata,
+        .flags = flags,
+        .arena = arena,
+        .line = 1,
+        .state = JSON__SAX_VALUE,
+    };
+}
+
+bool jsonSaxFeed(jsonsax_t *ctx, strview_t chunk) {
+    if (ctx->state == JSON__SAX_FAILED) {
+        return false;
+    }
+
+    const char *p = chunk.buf;
+    const char *end = chunk.buf + chunk.len;
+    ctx->chunk = chunk.buf;
+
+    while (p && p < end) {
+        switch (ctx->state) {
+            case JSON__SAX_STRING: p = json__sax_string(ctx, p, end); continue;
+            case JSON__SAX_SCALAR: p = json__sax_scalar(ctx, p, end); continue;
+        }
+
+        if (json__is_space(*p)) {
+            if (*p == '\n') {
+                json__sax_newline(ctx, p);
+            }
+            p++;
+            continue;
+        }
+
+        p = json__sax_token(ctx, p, end);
+    }
+
+    ctx->offset += chunk.len;
+    ctx->chunk = NULL;
+
+    return p != NULL;
+}
+
+// errors at the end of the input are the ones jsonParseStrFast gives for the same document
+bool jsonSaxFinish(jsonsax_t *ctx) {
+    switch (ctx->state) {
+        case JSON__SAX_FAILED:
+            return false;
+        case JSON__SAX_STRING:
+            json__sax_error_at(ctx, ctx->string_start, "unterminated string");
+            return false;
+        case JSON__SAX_SCALAR:
+        {
+            strview_t scalar = { ctx->token, ctx->token_len };
+            ctx->token_len = 0;
+            if (!json__sax_emit_scalar(ctx, ctx->offset - scalar.len, scalar)) {
+                return false;
+            }
+            break;
+        }
+    }
+
+    switch (ctx->state) {
+        case JSON__SAX_VALUE: // fallthrough
+        case JSON__SAX_VALUE_OR_END:
+            if (ctx->depth || !(ctx->flags & JSON_MULTIPLE_ROOTS)) {
+                json__sax_error(ctx, ctx->offset, "unexpected end of input, expected a value");
+                return false;
+            }
+            break;
+        case JSON__SAX_KEY: // fallthrough
+        case JSON__SAX_KEY_OR_END:
+            json__sax_error(ctx, ctx->offset, "unterminated object");
+            return false;
+        case JSON__SAX_COLON:
+            json__sax_error(ctx, ctx->offset, "expected ':' after key");
+            return false;
+        case JSON__SAX_AFTER_VALUE:
+            json__sax_error_at(ctx, ctx->open[ctx->depth - 1], json__sax_in_object(ctx) ? "unterminated object" : "unterminated array");
+            return false;
+    }
+
+    return true;
+}
+
+bool jsonSaxFile(arena_t scratch, strview_t filename, jsonflags_e flags, jsonsax_fn *callback, void *userdata, jsonerr_t *error) {
+    jsonerr_t local_error = {0};
+    if (!error) error = &local_error;
+    *error = (jsonerr_t){0};
+
+    file_t fp = fileOpen(scratch, filename, FILE_READ);
+    if (!fileIsValid(fp)) {
+        err("json: couldn't open %v", filename);
+        error->message = "couldn't open the file";
+        return false;
+    }
+
+    char *buf = alloc(&scratch, char, JSON_SAX_CHUNK, ALLOC_NOZERO);
+    jsonsax_t sax = jsonSaxInit(&scratch, flags, callback, userdata);
+
+    bool ok = true;
+    usize read = 0;
+    while (ok && (read = fileRead(fp, buf, JSON_SAX_CHUNK)) > 0) {
+        ok = jsonSaxFeed(&sax, (strview_t){ buf, read });
+    }
+    ok = ok && jsonSaxFinish(&sax);
+
+    fileClose(fp);
+
+    if (!ok) {
+        *error = sax.error;
+        if (error == &local_error) {
+            err("json: %s at %v:%zu:%zu", error->message, filename, error->line, error->column);
+        }
+    }
+
+    return ok;
+}
+
+// ndjson: the main thread reads the file into blocks that end on a newline and the workers
+// parse them a line at a time, so no thread ever needs more than a block and a line's tree
+
+typedef enum {
+    JSON__BLOCK_FREE,
+    JSON__BLOCK_READY,
+    // either being filled or being parsed
+    JSON__BLOCK_BUSY,
+} json__block_state_e;
+
+typedef struct {
+    char *buf;
+    usize len;
+    usize first_line;
+    json__block_state_e state;
+} json__lines_block_t;
+
+typedef struct {
+    json__lines_block_t blocks[JSON_LINES_MAX_THREADS * 2];
+    int block_count;
+    cmutex_t mtx;
+    // a block was queued or there is nothing left to read
+    condvar_t ready;
+    // a worker is done with a block
+    condvar_t freed;
+    bool done;
+    bool failed;
+    jsonflags_e flags;
+    jsonline_fn *callback;
+    void *userdata;
+} json__lines_t;
+
+static json__lines_block_t *json__lines_find(json__lines_t *ctx, json__block_state_e state) {
+    for (int i = 0; i < ctx->block_count; ++i) {
+        if (ctx->blocks[i].state == state) {
+            return &ctx->blocks[i];
+        }
+    }
+    return NULL;
+}
+
+static bool json__lines_parse(json__lines_t *ctx, arena_t *arena, json__lines_block_t *block) {
+    jsonopts_t opts = { .flags = ctx->flags };
+    bool ok = true;
+    usize line = block->first_line;
+    strview_t rest = { block->buf, block->len };
+
+    while (rest.len) {
+        const char *newline = memchr(rest.buf, '\n', rest.len);
+        strview_t text = { rest.buf, newline ? (usize)(newline - rest.buf) : rest.len };
+        rest = strvRemovePrefix(rest, text.len + (newline != NULL));
+
+        usize i = 0;
+        while (i < text.len && json__is_space(text.buf[i])) {
+            i++;
+        }
+
+        if (i < text.len) {
+            arena_temp_t temp = arenaTempBegin(arena);
+            jsonerr_t error = {0};
+            json_t json = jsonParseStrFast(arena, text, &opts, &error);
+            ok = ok && json;
+            if (ctx->callback) {
+                ctx->callback(ctx->userdata, line, json, &error);
+            }
+            arenaTempEnd(temp);
+        }
+
+        line++;
+    }
+
+    return ok;
+}
+
+static int json__lines_worker(void *userdata) {
+    json__lines_t *ctx = userdata;
+    arena_temp_t scratch = arenaGetScratch(NULL, 0);
+
+    mtxLock(ctx->mtx);
+    for (;;) {
+        json__lines_block_t *block = NULL;
+        while (!(block = json__lines_find(ctx, JSON__BLOCK_READY)) && !ctx->done) {
+            condWait(ctx->ready, ctx->mtx);
+        }
+        if (!block) {
+            break;
+        }
+        block->state = JSON__BLOCK_BUSY;
+        mtxUnlock(ctx->mtx);
+
+        bool ok = json__lines_parse(ctx, scratch.arena, block);
+
+        mtxLock(ctx->mtx);
+        block->state = JSON__BLOCK_FREE;
+        ctx->failed |= !ok;
+        condWake(ctx->freed);
+    }
+    mtxUnlock(ctx->mtx);
+
+    arenaTempEnd(scratch);
+    return 0;
+}
+
+bool jsonParseLines(arena_t scratch, strview_t filename, jsonflags_e flags, int thread_count, jsonline_fn *callback, void *userdata) {
+    file_t fp = fileOpen(scratch, filename, FILE_READ);
+    if (!fileIsValid(fp)) {
+        err("json: couldn't open %v", filename);
+        return false;
+    }
+
+    thread_count = thread_count < 1 ? 1 : thread_count > JSON_LINES_MAX_THREADS ? JSON_LINES_MAX_THREADS : thread_count;
+
+    json__lines_t *ctx = alloc(&scratch, json__lines_t);
+    ctx->block_count = thread_count * 2;
+    ctx->mtx = mtxInit();
+    ctx->ready = condInit();
+    ctx->freed = condInit();
+    ctx->flags = flags;
+    ctx->callback = callback;
+    ctx->userdata = userdata;
+
+    for (int i = 0; i < ctx->block_count; ++i) {
+        ctx->blocks[i].buf = alloc(&scratch, char, JSON_LINES_BLOCK, ALLOC_NOZERO);
+    }
+
+    // the unfinished last line of a block, it goes at the start of the next one
+    char *carry = alloc(&scratch, char, JSON_LINES_BLOCK, ALLOC_NOZERO);
+    usize carry_len = 0;
+
+    cthread_t threads[JSON_LINES_MAX_THREADS];
+    for (int i = 0; i < thread_count; ++i) {
+        threads[i] = thrCreate(json__lines_worker, ctx);
+    }
+
+    bool ok = true;
+    bool eof = false;
+    usize line = 0;
+
+    while (!eof) {
+        mtxLock(ctx->mtx);
+        json__lines_block_t *block = NULL;
+        while (!(block = json__lines_find(ctx, JSON__BLOCK_FREE))) {
+            condWait(ctx->freed, ctx->mtx);
+        }
+        block->state = JSON__BLOCK_BUSY;
+        mtxUnlock(ctx->mtx);
+
+        memcpy(block->buf, carry, carry_len);
+        usize len = carry_len;
+        while (len < JSON_LINES_BLOCK) {
+            usize read = fileRead(fp, block->buf + len, JSON_LINES_BLOCK - len);
+            if (!read) {
+                eof = true;
+                break;
+            }
+            len += read;
+        }
+
+        usize cut = len;
+        if (!eof) {
+            while (cut > 0 && block->buf[cut - 1] != '\n') {
+                cut--;
+            }
+            if (cut == 0) {
+                err("json: line %zu of %v is longer than %zu bytes", line + 1, filename, (usize)JSON_LINES_BLOCK);
+                ok = false;
+                eof = true;
+            }
+        }
+
+        carry_len = len - cut;
+        memcpy(carry, block->buf + cut, carry_len);
+
+        block->len = cut;
+        block->first_line = line;
+        for (const char *p = block->buf, *end = block->buf + cut; (p = memchr(p, '\n', end - p)); ++p) {
+            line++;
+        }
+
+        mtxLock(ctx->mtx);
+        block->state = cut ? JSON__BLOCK_READY : JSON__BLOCK_FREE;
+        condWake(ctx->ready);
+        mtxUnlock(ctx->mtx);
+    }
+
+    mtxLock(ctx->mtx);
+    ctx->done = true;
+    condWakeAll(ctx->ready);
+    mtxUnlock(ctx->mtx);
+
+    for (int i = 0; i < thread_count; ++i) {
+        thrJoin(threads[i], NULL);
+    }
+
+    ok = ok && !ctx->failed;
+
+    condFree(ctx->ready);
+    condFree(ctx->freed);
+    mtxFree(ctx->mtx);
+    fileClose(fp);
+
+    return ok;
+}
+
+// == OBJECT INDEX =================================================
+
+void jsonIndex(arena_t *arena, jsonval_t *node) {
+    if (!node || node->type != JSON_OBJECT || node->index) {
+        return;
+    }
+
+    uint32 count = 0;
+    for (jsonval_t *child = node->object; child; child = child->next) {
+        count++;
+    }
+
+    // at most half full
+    uint32 size = 8;
+    while (size < count * 2) {
+        size *= 2;
+    }
+
+    jsonindex_t *index = alloc(arena, jsonindex_t);
+    index->slots = alloc(arena, json__slot_t, size);
+    index->mask = size - 1;
+
+    for (jsonval_t *child = node->object; child; child = child->next) {
+        uint64 hash = internHash(strv(child->key));
+        uint32 i = (uint32)hash & index->mask;
+        bool duplicate = false;
+        while (index->slots[i].node) {
+            // jsonGet returns the first one with the same key, keep that one
+            if (strEquals(index->slots[i].node->key, child->key)) {
+                duplicate = true;
+                break;
+            }
+            i = (i + 1) & index->mask;
+        }
+        if (!duplicate) {
+            index->slots[i] = (json__slot_t){ (uint32)(hash >> 32), child };
+        }
+    }
+
+    node->index = index;
+}
+
+static jsonval_t *json__index_get(jsonindex_t *index, strview_t key) {
+    uint64 hash = internHash(key);
+    uint32 hash_hi = (uint32)(hash >> 32);
+
+    for (uint32 i = (uint32)hash & index->mask; index->slots[i].node; i = (i + 1) & index->mask) {
+        json__slot_t *slot = &index->slots[i];
+        if (slot->hash == hash_hi && strvEquals(strv(slot->node->key), key)) {
+            return slot->node;
+        }
+    }
+
+    return NULL;
+}
+
+jsonval_t *jsonGet(jsonval_t *node, strview_t key) {
+    if (!node) return NULL;
+
+    if (node->type != JSON_OBJECT) {
+        err("passed type is not an object");
+        return NULL;
+    }
+
+    if (node->index) {
+        return json__index_get(node->index, key);
+    }
+
+    node = node->object;
+
+    while (node) {
+        if (strvEquals(strv(node->key), key)) {
+            return node;
+        }
+        node = node->next;
+    }
+
+    return NULL;
+}
+
+jsonval_t *jsonGetAtom(jsonval_t *node, atom_t key) {
+    // keys that weren't interned have ATOM_NONE, it must not match them
+    if (!node || key == ATOM_NONE) return NULL;
+
+    if (node->type != JSON_OBJECT) {
+        err("passed type is not an object");
+        return NULL;
+    }
+
+    for (node = node->object; node; node = node->next) {
+        if (node->key_atom == key) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+// == WRITER =======================================================
+
+// obufWrite and obufPutc with the common case inlined, the writer mostly puts out a few bytes at a time
+static inline void json__put(obufstream_t *out, const char *buf, usize len) {
+    if ((usize)(out->end - out->cur) >= len) {
+        memcpy(out->cur, buf, len);
+        out->cur += len;
+    }
+    else {
+        obufWrite(out, buf, len);
+    }
+}
+
+static inline void json__putc(obufstream_t *out, char c) {
+    if (out->cur < out->end) {
+        *out->cur++ = c;
+    }
+    else {
+        obufPutc(out, c);
+    }
+}
+
+static bool json__needs_escape(char c) {
+    return c == '"' || c == '\\' || (uint8)c < 0x20;
+}
+
+// index of the first character from i that needs escaping, or len
+static usize json__find_escape(const char *buf, usize i, usize len) {
+#if JSON_AVX2
+    {
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i control = _mm256_set1_epi8(0x1f);
+        for (; i + 32 <= len; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(buf + i));
+            // max(v, 0x1f) == 0x1f only for bytes up to 0x1f
+            __m256i hit = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control)
+            );
+            uint32 mask = (uint32)_mm256_movemask_epi8(hit);
+            if (mask) {
+                return i + json__ctz64(mask);
+            }
+        }
+    }
+#endif
+#if JSON_SSE2
+    {
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1f);
+        for (; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+            __m128i hit = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(v, control), control)
+            );
+            uint32 mask = (uint32)_mm_movemask_epi8(hit);
+            if (mask) {
+                return i + json__ctz64(mask);
+            }
+        }
+    }
+#endif
+    for (; i < len; ++i) {
+        if (json__needs_escape(buf[i])) {
+            return i;
+        }
+    }
+    return len;
+}
+
+// most strings have nothing to escape, they go out with a single reserve and copy
+static void json__write_string(obufstream_t *out, strview_t v, bool escape) {
+    static const char hex[] = "0123456789abcdef";
+
+    usize i = escape ? json__find_escape(v.buf, 0, v.len) : v.len;
+
+    if (i == v.len) {
+        char *buf = obufReserve(out, v.len + 2);
+        if (!buf) return;
+        buf[0] = '"';
+        memcpy(buf + 1, v.buf, v.len);
+        buf[v.len + 1] = '"';
+        obufCommit(out, v.len + 2);
+        return;
+    }
+
+    json__putc(out, '"');
+
+    usize start = 0;
+    while (i < v.len) {
+        json__put(out, v.buf + start, i - start);
+
+        uint8 c = (uint8)v.buf[i];
+        char short_escape = 0;
+        switch (c) {
+            case '"':  short_escape = '"';  break;
+            case '\\': short_escape = '\\'; break;
+            case '\b': short_escape = 'b';  break;
+            case '\f': short_escape = 'f';  break;
+            case '\n': short_escape = 'n';  break;
+            case '\r': short_escape = 'r';  break;
+            case '\t': short_escape = 't';  break;
+        }
+
+        if (short_escape) {
+            json__put(out, (char[]){ '\\', short_escape }, 2);
+        }
+        else {
+            json__put(out, (char[]){ '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] }, 6);
+        }
+
+        start = i + 1;
+        i = json__find_escape(v.buf, start, v.len);
+    }
+
+    json__put(out, v.buf + start, v.len - start);
+    json__putc(out, '"');
+}
+
+static void json__write_newline(jsonwriter_t *ctx) {
+    usize len = 1 + ctx->depth * 4;
+    char *buf = obufReserve(ctx->out, len);
+    if (!buf) return;
+    buf[0] = '\n';
+    memset(buf + 1, ' ', len - 1);
+    obufCommit(ctx->out, len);
+}
+
+// separator and indentation before a key or a value
+static void json__write_prefix(jsonwriter_t *ctx) {
+    if (ctx->after_key) {
+        ctx->after_key = false;
+        return;
+    }
+
+    if (!ctx->first) {
+        json__putc(ctx->out, ctx->depth ? ',' : '\n');
+    }
+    ctx->first = false;
+
+    if (ctx->depth && (ctx->flags & JSON_WRITE_PRETTY)) {
+        json__write_newline(ctx);
+    }
+}
+
+static void json__write_begin(jsonwriter_t *ctx, char c) {
+    json__write_prefix(ctx);
+    json__putc(ctx->out, c);
+    ctx->depth++;
+    ctx->first = true;
+}
+
+static void json__write_end(jsonwriter_t *ctx, char c) {
+    assert(ctx->depth > 0 && !ctx->after_key);
+    ctx->depth--;
+    if (!ctx->first && (ctx->flags & JSON_WRITE_PRETTY)) {
+        json__write_newline(ctx);
+    }
+    json__putc(ctx->out, c);
+    ctx->first = false;
+}
+
+static void json__write_key(jsonwriter_t *ctx, strview_t key, bool escape) {
+    assert(ctx->depth > 0 && !ctx->after_key);
+    json__write_prefix(ctx);
+    json__write_string(ctx->out, key, escape);
+    json__put(ctx->out, ": ", ctx->flags & JSON_WRITE_PRETTY ? 2 : 1);
+    ctx->after_key = true;
+}
+
+jsonwriter_t jsonWriterInit(obufstream_t *out, jsonwriteflags_e flags) {
+    return (jsonwriter_t){
+        .out = out,
+        .flags = flags,
+        .first = true,
+    };
+}
+
+void jsonWriteBeginObject(jsonwriter_t *ctx) {
+    json__write_begin(ctx, '{');
+}
+
+void jsonWriteEndObject(jsonwriter_t *ctx) {
+    json__write_end(ctx, '}');
+}
+
+void jsonWriteBeginArray(jsonwriter_t *ctx) {
+    json__write_begin(ctx, '[');
+}
+
+void jsonWriteEndArray(jsonwriter_t *ctx) {
+    json__write_end(ctx, ']');
+}
+
+void jsonWriteKey(jsonwriter_t *ctx, strview_t key) {
+    json__write_key(ctx, key, true);
+}
+
+void jsonWriteKeyRaw(jsonwriter_t *ctx, strview_t key) {
+    json__write_key(ctx, key, false);
+}
+
+void jsonWriteString(jsonwriter_t *ctx, strview_t value) {
+    json__write_prefix(ctx);
+    json__write_string(ctx->out, value, true);
+}
+
+void jsonWriteStringRaw(jsonwriter_t *ctx, strview_t value) {
+    json__write_prefix(ctx);
+    json__write_string(ctx->out, value, false);
+}
+
+void jsonWriteNumber(jsonwriter_t *ctx, double value) {
+    json__write_prefix(ctx);
+    if (isfinite(value)) {
+        obufAppendNum(ctx->out, value);
+    }
+    else {
+        json__put(ctx->out, "null", 4);
+    }
+}
+
+void jsonWriteInt(jsonwriter_t *ctx, int64 value) {
+    json__write_prefix(ctx);
+    obufAppendInt(ctx->out, value);
+}
+
+void jsonWriteBool(jsonwriter_t *ctx, bool value) {
+    json__write_prefix(ctx);
+    json__put(ctx->out, value ? "true" : "false", value ? 4 : 5);
+}
+
+void jsonWriteNull(jsonwriter_t *ctx) {
+    json__write_prefix(ctx);
+    json__put(ctx->out, "null", 4);
+}
+
+void jsonWriteValue(jsonwriter_t *ctx, jsonval_t *value) {
+    if (!value) {
+        jsonWriteNull(ctx);
+        return;
+    }
+
+    bool escape = ctx->flags & JSON_WRITE_ESCAPE_TREE;
+
+    switch (value->type) {
+        case JSON_NULL:
+            jsonWriteNull(ctx);
+            break;
+        case JSON_ARRAY:
+            jsonWriteBeginArray(ctx);
+            for (jsonval_t *child = value->array; child; child = child->next) {
+                jsonWriteValue(ctx, child);
+            }
+            jsonWriteEndArray(ctx);
+            break;
+        case JSON_OBJECT:
+            jsonWriteBeginObject(ctx);
+            for (jsonval_t *child = value->object; child; child = child->next) {
+                json__write_key(ctx, strv(child->key), escape);
+                jsonWriteValue(ctx, child);
+            }
+            jsonWriteEndObject(ctx);
+            break;
+        case JSON_STRING:
+            json__write_prefix(ctx);
+            json__write_string(ctx->out, strv(value->string), escape);
+            break;
+        case JSON_NUMBER:
+            jsonWriteNumber(ctx, value->number);
+            break;
+        case JSON_BOOL:
+            jsonWriteBool(ctx, value->boolean);
+            break;
+    }
+}
+
+bool jsonWrite(obufstream_t *out, json_t json, jsonwriteflags_e flags) {
+    jsonwriter_t ctx = jsonWriterInit(out, flags);
+    jsonWriteValue(&ctx, json);
+    return !out->failed;
+}
+
+str_t jsonWriteStr(arena_t *arena, json_t json, jsonwriteflags_e flags) {
+    obufstream_t out = obufInit(arena, KB(4));
+    jsonWrite(&out, json, flags);
+    return obufAsStr(&out);
+}
+
+bool jsonWriteFile(arena_t scratch, strview_t filename, json_t json, jsonwriteflags_e flags) {
+    file_t fp = fileOpen(scratch, filename, FILE_WRITE);
+    if (!fileIsValid(fp)) {
+        err("json: couldn't open %v", filename);
+        return false;
+    }
+
+    obufstream_t out = obufInitSink(&scratch, KB(64), fileSink, &fp);
+    bool ok = jsonWrite(&out, json, flags) && obufFlush(&out);
+
+    fileClose(fp);
+    return ok;
+}
+
+#include "warnings/colla_warn_end.h"
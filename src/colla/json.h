@@ -2,6 +2,8 @@
 
 #include "str.h"
 #include "arena.h"
+#include "intern.h"
+#include "strstream.h"
 
 typedef enum {
     JSON_NULL,
@@ -16,32 +18,212 @@ typedef enum {
     JSON_DEFAULT            = 0,
     JSON_NO_TRAILING_COMMAS = 1 << 0,
     JSON_NO_COMMENTS        = 1 << 1,
+    // only used by the streaming parser, accepts any number of root values one after the other (e.g. ndjson)
+    JSON_MULTIPLE_ROOTS     = 1 << 2,
 } jsonflags_e;
 
 typedef struct jsonval_t jsonval_t;
+typedef struct jsonindex_t jsonindex_t;
 
 typedef struct jsonval_t {
     jsonval_t *next;
     jsonval_t *prev;
 
     str_t key;
+    // only set when parsed with an intern table, see jsonopts_t
+    atom_t key_atom;
 
     union {
         jsonval_t *array;
         str_t string;
         double number;
         bool boolean;
-        jsonval_t *object;
+        struct {
+            jsonval_t *object;
+            // hash index of the keys, NULL until jsonIndex is called or
+            // if the object was smaller than jsonopts_t.index_min_keys
+            jsonindex_t *index;
+        };
     };
     jsontype_e type;
 } jsonval_t;
 
 typedef jsonval_t *json_t;
 
+typedef struct {
+    jsonflags_e flags;
+    // nodes come from pool (see poolMake), strings still come from arena
+    arena_pool_t *pool;
+    // keys are interned instead of copied to arena and key_atom is set, so lookups can use jsonGetAtom
+    intern_t *intern;
+    // objects with at least this many keys get a hash index while parsing, 0 never builds one
+    uint32 index_min_keys;
+} jsonopts_t;
+
+typedef struct {
+    // NULL if there was no error, always a string literal
+    const char *message;
+    usize offset;
+    // 1-based
+    usize line;
+    usize column;
+} jsonerr_t;
+
 json_t jsonParse(arena_t *arena, arena_t scratch, strview_t filename, jsonflags_e flags);
 json_t jsonParseStr(arena_t *arena, strview_t jsonstr, jsonflags_e flags);
+// nodes come from pool (see poolMake), strings still come from arena
+json_t jsonParseStrPool(arena_t *arena, arena_pool_t *pool, strview_t jsonstr, jsonflags_e flags);
+json_t jsonParseStrOpts(arena_t *arena, strview_t jsonstr, const jsonopts_t *opts);
+// builds the same tree as jsonParseStrOpts, but finds every structural character with simd first
+// and returns NULL on malformed input instead of calling fatal. if error is NULL the error is logged.
+// comments aren't supported yet
+json_t jsonParseStrFast(arena_t *arena, strview_t jsonstr, const jsonopts_t *opts, jsonerr_t *error);
+// gives every node back to the pool they were parsed with, does nothing if pool is NULL
+void jsonFree(arena_pool_t *pool, json_t json);
 
+// uses the object's index if it has one, otherwise walks the keys
 jsonval_t *jsonGet(jsonval_t *node, strview_t key);
+// builds the hash index for an object, stored in arena. does nothing if it already has one,
+// so it can be called right before lookups. the index goes stale if keys are added or removed
+void jsonIndex(arena_t *arena, jsonval_t *node);
+// only works on trees parsed with an intern table, compares atoms instead of strings.
+// ATOM_NONE (e.g. from internFind on a key that was never added) finds nothing
+jsonval_t *jsonGetAtom(jsonval_t *node, atom_t key);
 
 #define json_check(val, js_type) ((val) && (val)->type == js_type)
 #define json_for(name, arr) for (jsonval_t *name = json_check(arr, JSON_ARRAY) ? arr->array : NULL; name; name = name->next)
+
+// == STREAMING PARSER =============================================
+
+// deepest nesting jsonParseStrFast and the streaming parser accept
+#define JSON_MAX_DEPTH 1024
+// ndjson lines are handed to the workers in blocks of this size
+#define JSON_LINES_BLOCK MB(4)
+
+typedef enum {
+    JSON_EVENT_OBJECT_BEGIN,
+    JSON_EVENT_OBJECT_END,
+    JSON_EVENT_ARRAY_BEGIN,
+    JSON_EVENT_ARRAY_END,
+    JSON_EVENT_KEY,
+    JSON_EVENT_STRING,
+    JSON_EVENT_NUMBER,
+    JSON_EVENT_BOOL,
+    JSON_EVENT_NULL,
+} jsonevent_e;
+
+typedef struct {
+    jsonevent_e type;
+    // key or string, escapes are kept like in the tree. only valid until the callback returns
+    strview_t string;
+    double number;
+    bool boolean;
+    // number of containers the event is in, the root object's begin and end are at 0 and its keys at 1
+    uint32 depth;
+} jsonevent_t;
+
+// return false to stop parsing, the parser then fails with "stopped by the callback"
+typedef bool (jsonsax_fn)(void *userdata, const jsonevent_t *event);
+
+// private, where a string or a container starts, for the errors that point back at it
+typedef struct {
+    usize offset;
+    usize line;
+    usize column;
+} jsonsax_pos_t;
+
+typedef struct {
+    jsonsax_fn *callback;
+    void *userdata;
+    jsonflags_e flags;
+    // message is set once feeding or finishing fails, every call after that does nothing
+    jsonerr_t error;
+
+    // private
+    arena_t *arena;
+    // strings and scalars split between two chunks are put back together here
+    char *token;
+    usize token_len;
+    usize token_cap;
+    const char *chunk;
+    usize offset;
+    usize line;
+    usize line_start;
+    uint32 depth;
+    uint8 state;
+    bool is_key;
+    bool escape;
+    jsonsax_pos_t string_start;
+    // where every open container starts, grown in arena
+    jsonsax_pos_t *open;
+    uint32 open_cap;
+    // one bit per open container, set for objects
+    uint64 stack[JSON_MAX_DEPTH / 64];
+} jsonsax_t;
+
+// arena is only used when a string or number is split between two chunks, it never grows past
+// twice the size of the biggest one. the chunks can be split anywhere and don't need to outlive jsonSaxFeed
+jsonsax_t jsonSaxInit(arena_t *arena, jsonflags_e flags, jsonsax_fn *callback, void *userdata);
+bool jsonSaxFeed(jsonsax_t *ctx, strview_t chunk);
+// call after the last chunk, fails if the input stopped in the middle of a value
+bool jsonSaxFinish(jsonsax_t *ctx);
+// feeds the whole file a block at a time. if error is NULL the error is logged
+bool jsonSaxFile(arena_t scratch, strview_t filename, jsonflags_e flags, jsonsax_fn *callback, void *userdata, jsonerr_t *error);
+
+// called for every line of an ndjson file from the worker threads, in no particular order.
+// line is 0-based, json is NULL if the line is malformed and error says why. the tree is only
+// valid until the callback returns
+typedef void (jsonline_fn)(void *userdata, usize line, json_t json, const jsonerr_t *error);
+
+// parses every line of a newline delimited json file as its own document (using jsonParseStrFast)
+// across thread_count threads. the file is read a block at a time, so memory doesn't depend on its size,
+// but a single line can't be longer than JSON_LINES_BLOCK. blank lines are skipped.
+// returns false if the file couldn't be read or any line was malformed
+bool jsonParseLines(arena_t scratch, strview_t filename, jsonflags_e flags, int thread_count, jsonline_fn *callback, void *userdata);
+
+// == WRITER =======================================================
+
+typedef enum {
+    JSON_WRITE_COMPACT     = 0,
+    // newlines and 4 spaces of indentation per level
+    JSON_WRITE_PRETTY      = 1 << 0,
+    // the parsers keep the escapes in strings and keys, so trees are written as they are.
+    // set this for trees built by hand with plain text, that needs escaping
+    JSON_WRITE_ESCAPE_TREE = 1 << 1,
+} jsonwriteflags_e;
+
+// writes json straight to an obufstream_t without building a tree. the stream can be in memory (obufInit),
+// or go to a file (fileSink), a socket (skSendSink) or an outstream_t (ostrSink).
+// commas, colons and indentation are added as needed, root values after the first one go on a new line (ndjson)
+typedef struct {
+    obufstream_t *out;
+    jsonwriteflags_e flags;
+    uint32 depth;
+    // nothing was written yet in the current container
+    bool first;
+    bool after_key;
+} jsonwriter_t;
+
+jsonwriter_t jsonWriterInit(obufstream_t *out, jsonwriteflags_e flags);
+
+void jsonWriteBeginObject(jsonwriter_t *ctx);
+void jsonWriteEndObject(jsonwriter_t *ctx);
+void jsonWriteBeginArray(jsonwriter_t *ctx);
+void jsonWriteEndArray(jsonwriter_t *ctx);
+// key and string are escaped, use the raw versions for text that already is
+void jsonWriteKey(jsonwriter_t *ctx, strview_t key);
+void jsonWriteKeyRaw(jsonwriter_t *ctx, strview_t key);
+void jsonWriteString(jsonwriter_t *ctx, strview_t value);
+void jsonWriteStringRaw(jsonwriter_t *ctx, strview_t value);
+// nan and infinity aren't valid json, they are written as null
+void jsonWriteNumber(jsonwriter_t *ctx, double value);
+void jsonWriteInt(jsonwriter_t *ctx, int64 value);
+void jsonWriteBool(jsonwriter_t *ctx, bool value);
+void jsonWriteNull(jsonwriter_t *ctx);
+// writes a whole tree, a NULL value is written as null
+void jsonWriteValue(jsonwriter_t *ctx, jsonval_t *value);
+
+// doesn't flush out, returns false if its sink failed
+bool jsonWrite(obufstream_t *out, json_t json, jsonwriteflags_e flags);
+str_t jsonWriteStr(arena_t *arena, json_t json, jsonwriteflags_e flags);
+bool jsonWriteFile(arena_t scratch, strview_t filename, json_t json, jsonwriteflags_e flags);
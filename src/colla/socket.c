@@ -1,5 +1,7 @@
 #include "socket.h"
 
+#include <limits.h>
+
 #if COLLA_WIN && COLLA_CMT_LIB
 #pragma comment(lib, "Ws2_32")
 #endif
@@ -156,6 +158,21 @@ int skSendPro(socket_t sock, const void *buf, int len, int flags) {
     return send(sock, buf, len, flags);
 }
 
+usize skSendSink(void *userdata, const void *buf, usize len) {
+    socket_t sock = *(socket_t *)userdata;
+    const char *data = buf;
+    usize sent = 0;
+    while (sent < len) {
+        usize chunk = len - sent;
+        int result = skSend(sock, data + sent, chunk > INT_MAX ? INT_MAX : (int)chunk);
+        if (result <= 0) {
+            break;
+        }
+        sent += (usize)result;
+    }
+    return sent;
+}
+
 int skSendTo(socket_t sock, const void *buf, int len, const skaddrin_t *to) {
     return skSendToPro(sock, buf, len, 0, (skaddr_t*)to, sizeof(skaddrin_t));
 }
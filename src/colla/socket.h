@@ -69,6 +69,8 @@ bool skConnectPro(socket_t sock, const skaddr_t *name, int namelen);
 int skSend(socket_t sock, const void *buf, int len);
 // Sends data on a socket, returns true on success
 int skSendPro(socket_t sock, const void *buf, int len, int flags);
+// obufsink_fn (see strstream.h), userdata is a socket_t *, keeps sending until everything is sent or on error
+usize skSendSink(void *userdata, const void *buf, usize len);
 // Sends data to a specific destination
 int skSendTo(socket_t sock, const void *buf, int len, const skaddrin_t *to);
 // Sends data to a specific destination
@@ -17,6 +17,31 @@
 
 #endif
 
+#if COLLA_MSVC
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define STR_AVX2 1
+#include <immintrin.h>
+#else
+#define STR_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STR_SSE2 1
+#include <emmintrin.h>
+#else
+#define STR_SSE2 0
+#endif
+
+#if !STR_SSE2 && (defined(__ARM_NEON) || defined(_M_ARM64))
+#define STR_NEON 1
+#include <arm_neon.h>
+#else
+#define STR_NEON 0
+#endif
+
 // == STR_T ========================================================
 
 str_t strInit(arena_t *arena, const char *buf) {
@@ -48,17 +73,75 @@ str_t strFmt(arena_t *arena, const char *fmt, ...) {
     return out;
 }
 
+typedef struct {
+    arena_t *arena;
+    char *start;
+    usize len;
+    // used when the arena can't fit a whole chunk
+    char fallback[FMT_CHUNK_SIZE];
+} str__fmt_t;
+
+// copies data right after what was already written, if the arena can't grow in place (chained arenas
+// moving to a new block) everything written so far is moved to the new spot
+static void str__fmt_append(str__fmt_t *ctx, const char *data, usize len) {
+    char *dst = NULL;
+    if (ctx->len == 0) {
+        dst = ctx->start = alloc(ctx->arena, char, len, ALLOC_NOZERO);
+    }
+    else if (arenaRemaining(ctx->arena) >= len) {
+        dst = alloc(ctx->arena, char, len, ALLOC_NOZERO);
+    }
+    else {
+        char *moved = alloc(ctx->arena, char, ctx->len + len, ALLOC_NOZERO);
+        memcpy(moved, ctx->start, ctx->len);
+        ctx->start = moved;
+        dst = moved + ctx->len;
+    }
+    memcpy(dst, data, len);
+    ctx->len += len;
+}
+
+static char *str__fmt_next_chunk(str__fmt_t *ctx) {
+    if (arenaRemaining(ctx->arena) < FMT_CHUNK_SIZE) {
+        return ctx->fallback;
+    }
+    char *chunk = alloc(ctx->arena, char, FMT_CHUNK_SIZE, ALLOC_NOZERO);
+    if (ctx->len == 0) {
+        ctx->start = chunk;
+    }
+    return chunk;
+}
+
+static char *str__fmt_callback(const char *buf, void *userdata, int len) {
+    str__fmt_t *ctx = userdata;
+
+    if (buf == ctx->fallback) {
+        str__fmt_append(ctx, buf, len);
+    }
+    else {
+        // the chunk was already written in place, give back what wasn't used
+        arenaPop(ctx->arena, FMT_CHUNK_SIZE - len);
+        ctx->len += len;
+    }
+
+    return str__fmt_next_chunk(ctx);
+}
+
 str_t strFmtv(arena_t *arena, const char *fmt, va_list args) {
-    va_list vcopy;
-    va_copy(vcopy, args);
-    // stb_vsnprintf returns the length + null_term
-    int len = fmtBufferv(NULL, 0, fmt, vcopy);
-    va_end(vcopy);
+    if (!arena) return (str_t){0};
 
-    char *buffer = alloc(arena, char, len + 1);
-    fmtBufferv(buffer, len + 1, fmt, args);
+    // single pass, formats straight into the arena in chunks
+    str__fmt_t ctx = { .arena = arena };
+    fmtCallbackv(str__fmt_callback, &ctx, str__fmt_next_chunk(&ctx), fmt, args);
 
-    return (str_t) { .buf = buffer, .len = (usize)len };
+    // the last callback always asks for one more chunk
+    if (ctx.start && (char *)arena->current == ctx.start + ctx.len + FMT_CHUNK_SIZE) {
+        arenaPop(arena, FMT_CHUNK_SIZE);
+    }
+
+    str__fmt_append(&ctx, "", 1);
+
+    return (str_t) { .buf = ctx.start, .len = ctx.len - 1 };
 }
 
 str_t strFromWChar(arena_t *arena, const wchar_t *src, usize srclen) {
@@ -165,6 +248,222 @@ str_t strToUpper(arena_t *arena, str_t ctx) {
 }
 
 
+// == SEARCH =======================================================
+
+// everything works on 16 byte vectors, masks have 1 << STR_VEC_SHIFT bits per byte.
+// with avx2 the single byte search also goes through 32 bytes at a time
+
+#if STR_SSE2
+
+#define STR_VEC 1
+#define STR_VEC_SHIFT 0
+typedef __m128i str__vec_t;
+
+static inline str__vec_t str__vec_load(const char *p)           { return _mm_loadu_si128((const __m128i *)p); }
+static inline str__vec_t str__vec_set(char c)                   { return _mm_set1_epi8(c); }
+static inline str__vec_t str__vec_eq(str__vec_t a, str__vec_t b)  { return _mm_cmpeq_epi8(a, b); }
+static inline str__vec_t str__vec_or(str__vec_t a, str__vec_t b)  { return _mm_or_si128(a, b); }
+static inline str__vec_t str__vec_and(str__vec_t a, str__vec_t b) { return _mm_and_si128(a, b); }
+static inline uint64 str__vec_mask(str__vec_t v)                { return (uint32)_mm_movemask_epi8(v); }
+
+#elif STR_NEON
+
+#define STR_VEC 1
+#define STR_VEC_SHIFT 2
+typedef uint8x16_t str__vec_t;
+
+static inline str__vec_t str__vec_load(const char *p)           { return vld1q_u8((const uint8 *)p); }
+static inline str__vec_t str__vec_set(char c)                   { return vdupq_n_u8((uint8)c); }
+static inline str__vec_t str__vec_eq(str__vec_t a, str__vec_t b)  { return vceqq_u8(a, b); }
+static inline str__vec_t str__vec_or(str__vec_t a, str__vec_t b)  { return vorrq_u8(a, b); }
+static inline str__vec_t str__vec_and(str__vec_t a, str__vec_t b) { return vandq_u8(a, b); }
+// there is no movemask, narrowing every 16 bit lane by 4 leaves a nibble per byte
+static inline uint64 str__vec_mask(str__vec_t v) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+}
+
+#else
+
+#define STR_VEC 0
+
+#endif
+
+static inline int str__ctz64(uint64 v) {
+#if COLLA_MSVC
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (int)index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static inline int str__high_bit64(uint64 v) {
+#if COLLA_MSVC
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+static usize str__find_byte(const char *buf, usize len, char c) {
+    usize i = 0;
+
+#if STR_AVX2
+    __m256i needle32 = _mm256_set1_epi8(c);
+    for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(buf + i));
+        uint32 mask = (uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32));
+        if (mask) {
+            return i + str__ctz64(mask);
+        }
+    }
+#endif
+
+#if STR_VEC
+    str__vec_t needle = str__vec_set(c);
+    for (; i + 16 <= len; i += 16) {
+        uint64 mask = str__vec_mask(str__vec_eq(str__vec_load(buf + i), needle));
+        if (mask) {
+            return i + (str__ctz64(mask) >> STR_VEC_SHIFT);
+        }
+    }
+#endif
+
+    for (; i < len; ++i) {
+        if (buf[i] == c) {
+            return i;
+        }
+    }
+
+    return STR_NONE;
+}
+
+static usize str__rfind_byte(const char *buf, usize len, char c) {
+#if STR_VEC
+    str__vec_t needle = str__vec_set(c);
+    for (; len >= 16; len -= 16) {
+        uint64 mask = str__vec_mask(str__vec_eq(str__vec_load(buf + len - 16), needle));
+        if (mask) {
+            return len - 16 + (str__high_bit64(mask) >> STR_VEC_SHIFT);
+        }
+    }
+#endif
+
+    while (len--) {
+        if (buf[len] == c) {
+            return len;
+        }
+    }
+
+    return STR_NONE;
+}
+
+// the set is usually a couple of characters (" >", "\r\n", ...), up to 4 are compared
+// directly, bigger sets go through a lookup table one byte at a time
+#define STR_FIND_ANY_VEC_MAX 4
+
+static usize str__find_any_table(const char *buf, usize len, const char *set, usize set_len) {
+    bool table[256] = {0};
+    for (usize n = 0; n < set_len; ++n) {
+        table[(uint8)set[n]] = true;
+    }
+
+    for (usize i = 0; i < len; ++i) {
+        if (table[(uint8)buf[i]]) {
+            return i;
+        }
+    }
+
+    return STR_NONE;
+}
+
+static usize str__find_any(const char *buf, usize len, const char *set, usize set_len) {
+    if (set_len == 0) return STR_NONE;
+    if (set_len == 1) return str__find_byte(buf, len, set[0]);
+
+    usize i = 0;
+
+    if (set_len <= STR_FIND_ANY_VEC_MAX) {
+        // pad the set with its first character, so every check is always against 4 of them
+        char c0 = set[0], c1 = set[1];
+        char c2 = set_len > 2 ? set[2] : c0;
+        char c3 = set_len > 3 ? set[3] : c0;
+
+#define STR_IS_ANY(ch) ((ch) == c0 || (ch) == c1 || (ch) == c2 || (ch) == c3)
+
+#if STR_VEC
+        str__vec_t v0 = str__vec_set(c0), v1 = str__vec_set(c1);
+        str__vec_t v2 = str__vec_set(c2), v3 = str__vec_set(c3);
+
+        for (; i + 16 <= len; i += 16) {
+            str__vec_t chunk = str__vec_load(buf + i);
+            str__vec_t eq = str__vec_or(
+                str__vec_or(str__vec_eq(chunk, v0), str__vec_eq(chunk, v1)),
+                str__vec_or(str__vec_eq(chunk, v2), str__vec_eq(chunk, v3))
+            );
+            uint64 mask = str__vec_mask(eq);
+            if (mask) {
+                return i + (str__ctz64(mask) >> STR_VEC_SHIFT);
+            }
+        }
+#endif
+
+        for (; i < len; ++i) {
+            if (STR_IS_ANY(buf[i])) {
+                return i;
+            }
+        }
+
+#undef STR_IS_ANY
+
+        return STR_NONE;
+    }
+
+    return str__find_any_table(buf, len, set, set_len);
+}
+
+// compares the first and last character of the needle at 16 positions at once,
+// only the positions where both match are checked with memcmp
+static usize str__find_view(const char *buf, usize len, const char *needle, usize needle_len) {
+    if (needle_len == 0)  return 0;
+    if (needle_len > len) return STR_NONE;
+    if (needle_len == 1)  return str__find_byte(buf, len, needle[0]);
+
+    usize i = 0;
+    usize last = needle_len - 1;
+
+#if STR_VEC
+    str__vec_t first_char = str__vec_set(needle[0]);
+    str__vec_t last_char = str__vec_set(needle[last]);
+    const uint64 lane_bits = (1u << (1 << STR_VEC_SHIFT)) - 1;
+
+    for (; i + last + 16 <= len; i += 16) {
+        str__vec_t eq_first = str__vec_eq(str__vec_load(buf + i), first_char);
+        str__vec_t eq_last = str__vec_eq(str__vec_load(buf + i + last), last_char);
+        uint64 mask = str__vec_mask(str__vec_and(eq_first, eq_last));
+
+        while (mask) {
+            int bit = str__ctz64(mask) >> STR_VEC_SHIFT;
+            if (memcmp(buf + i + bit + 1, needle + 1, needle_len - 2) == 0) {
+                return i + bit;
+            }
+            mask &= ~(lane_bits << (bit << STR_VEC_SHIFT));
+        }
+    }
+#endif
+
+    for (; i + needle_len <= len; ++i) {
+        if (buf[i] == needle[0] && memcmp(buf + i + 1, needle + 1, last) == 0) {
+            return i;
+        }
+    }
+
+    return STR_NONE;
+}
+
 // == STRVIEW_T ====================================================
 
 strview_t strvInit(const char *cstr) {
@@ -323,58 +622,38 @@ bool strvEndsWith(strview_t ctx, char c) {
 }
 
 bool strvEndsWithView(strview_t ctx, strview_t view) {
-    return ctx.len >= view.len && memcmp(ctx.buf + ctx.len, view.buf, view.len) == 0;
+    return ctx.len >= view.len && memcmp(ctx.buf + ctx.len - view.len, view.buf, view.len) == 0;
 }
 
 bool strvContains(strview_t ctx, char c) {
-    for(usize i = 0; i < ctx.len; ++i) {
-        if(ctx.buf[i] == c) {
-            return true;
-        }
-    }
-    return false;
+    return str__find_byte(ctx.buf, ctx.len, c) != STR_NONE;
 }
 
 bool strvContainsView(strview_t ctx, strview_t view) {
-    if (ctx.len < view.len) return false;
-    usize end = ctx.len - view.len;
-    for (usize i = 0; i < end; ++i) {
-        if (memcmp(ctx.buf + i, view.buf, view.len) == 0) {
-            return true;
-        }
-    }
-    return false;
+    return str__find_view(ctx.buf, ctx.len, view.buf, view.len) != STR_NONE;
 }
 
 usize strvFind(strview_t ctx, char c, usize from) {
-    for (usize i = from; i < ctx.len; ++i) {
-        if (ctx.buf[i] == c) {
-            return i;
-        }
-    }
-    return STR_NONE;
+    if (from >= ctx.len) return STR_NONE;
+    usize pos = str__find_byte(ctx.buf + from, ctx.len - from, c);
+    return pos == STR_NONE ? STR_NONE : from + pos;
 }
 
 usize strvFindView(strview_t ctx, strview_t view, usize from) {
-    if (ctx.len < view.len) return STR_NONE;
-    usize end = ctx.len - view.len;
-    for (usize i = from; i < end; ++i) {
-        if (memcmp(ctx.buf + i, view.buf, view.len) == 0) {
-            return i;
-        }
-    }
-    return STR_NONE;
+    if (from > ctx.len) return STR_NONE;
+    usize pos = str__find_view(ctx.buf + from, ctx.len - from, view.buf, view.len);
+    return pos == STR_NONE ? STR_NONE : from + pos;
+}
+
+usize strvFindEither(strview_t ctx, strview_t chars, usize from) {
+    if (from >= ctx.len) return STR_NONE;
+    usize pos = str__find_any(ctx.buf + from, ctx.len - from, chars.buf, chars.len);
+    return pos == STR_NONE ? STR_NONE : from + pos;
 }
 
 usize strvRFind(strview_t ctx, char c, usize from_right) {
-    if (from_right > ctx.len) from_right = ctx.len;
-    isize end = (isize)(ctx.len - from_right);
-    for (isize i = end; i >= 0; --i) {
-        if (ctx.buf[i] == c) {
-            return (usize)i;
-        }
-    }
-    return STR_NONE;
+    if (from_right >= ctx.len) return STR_NONE;
+    return str__rfind_byte(ctx.buf, ctx.len - from_right, c);
 }
 
 usize strvRFindView(strview_t ctx, strview_t view, usize from_right) {
@@ -104,6 +104,8 @@ bool strvContainsView(strview_t ctx, strview_t view);
 
 usize strvFind(strview_t ctx, char c, usize from);
 usize strvFindView(strview_t ctx, strview_t view, usize from);
+// first position of any of the characters in chars
+usize strvFindEither(strview_t ctx, strview_t chars, usize from);
 
 usize strvRFind(strview_t ctx, char c, usize from_right);
 usize strvRFindView(strview_t ctx, strview_t view, usize from_right);
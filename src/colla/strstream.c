@@ -9,16 +9,37 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <math.h> // HUGE_VALF
+#include <assert.h>
 
 #include "tracelog.h"
 #include "arena.h"
+#include "format.h"
+#include "strstream_pow10.h"
 
-#if COLLA_WIN && COLLA_TCC
-#define strtoull _strtoui64
-#define strtoll _strtoi64
-#define strtof strtod
+#if COLLA_MSVC
+#include <intrin.h>
 #endif
 
+typedef struct {
+    int mant_bits;
+    int exp_bits;
+    int bias;
+} istr__float_info_t;
+
+static const istr__float_info_t istr__f64 = { 52, 11, -1023 };
+static const istr__float_info_t istr__f32 = { 23,  8,  -127 };
+
+static bool istr__get_uint(instream_t *ctx, uint64 max, uint64 *val, const char *name);
+static bool istr__get_int(instream_t *ctx, int64 min, int64 max, int64 *val, const char *name);
+static const char *istr__get_float(instream_t *ctx, const istr__float_info_t *info, uint64 *bits);
+
+// big enough for any number written by ostr__format_*
+#define OSTR_NUM_MAX 32
+
+static usize ostr__format_uint(char *buf, uint64 val);
+static usize ostr__format_int(char *buf, int64 val);
+static usize ostr__format_double(char *buf, double val);
+
 /* == INPUT STREAM ============================================ */
 
 instream_t istrInit(const char *str) {
@@ -37,9 +58,12 @@ char istrGet(instream_t *ctx) {
 }
 
 void istrIgnore(instream_t *ctx, char delim) {
-    for (; !istrIsFinished(*ctx) && *ctx->cur != delim; ++ctx->cur) {
-
+    if (istrIsFinished(*ctx)) {
+        return;
     }
+    usize remaining = istrRemaining(*ctx);
+    usize pos = strvFind(strvInitLen(ctx->cur, remaining), delim, 0);
+    ctx->cur += pos == STR_NONE ? remaining : pos;
 }
 
 void istrIgnoreAndSkip(instream_t *ctx, char delim) {
@@ -124,150 +148,67 @@ bool istrGetBool(instream_t *ctx, bool *val) {
 }
 
 bool istrGetU8(instream_t *ctx, uint8 *val) {
-    char *end = NULL;
-    *val = (uint8) strtoul(ctx->cur, &end, 0);
-    
-    if(ctx->cur == end) {
-        warn("istrGetU8: no valid conversion could be performed");
-        return false;
-    }
-    else if(*val == UINT8_MAX) {
-        warn("istrGetU8: value read is out of the range of representable values");
-        return false;
-    }
-
-    ctx->cur = end;
-    return true;
+    uint64 out = 0;
+    bool ok = istr__get_uint(ctx, UINT8_MAX, &out, "istrGetU8");
+    *val = (uint8)out;
+    return ok;
 }
 
 bool istrGetU16(instream_t *ctx, uint16 *val) {
-    char *end = NULL;
-    *val = (uint16) strtoul(ctx->cur, &end, 0);
-    
-    if(ctx->cur == end) {
-        warn("istrGetU16: no valid conversion could be performed");
-        return false;
-    }
-    else if(*val == UINT16_MAX) {
-        warn("istrGetU16: value read is out of the range of representable values");
-        return false;
-    }
-    
-    ctx->cur = end;
-    return true;
+    uint64 out = 0;
+    bool ok = istr__get_uint(ctx, UINT16_MAX, &out, "istrGetU16");
+    *val = (uint16)out;
+    return ok;
 }
 
 bool istrGetU32(instream_t *ctx, uint32 *val) {
-    char *end = NULL;
-    *val = (uint32) strtoul(ctx->cur, &end, 0);
-    
-    if(ctx->cur == end) {
-        warn("istrGetU32: no valid conversion could be performed");
-        return false;
-    }
-    else if(*val == UINT32_MAX) {
-        warn("istrGetU32: value read is out of the range of representable values");
-        return false;
-    }
-    
-    ctx->cur = end;
-    return true;
+    uint64 out = 0;
+    bool ok = istr__get_uint(ctx, UINT32_MAX, &out, "istrGetU32");
+    *val = (uint32)out;
+    return ok;
 }
 
 bool istrGetU64(instream_t *ctx, uint64 *val) {
-    char *end = NULL;
-    *val = strtoull(ctx->cur, &end, 0);
-    
-    if(ctx->cur == end) {
-        warn("istrGetU64: no valid conversion could be performed");
-        return false;
-    }
-    else if(*val == ULLONG_MAX) {
-        warn("istrGetU64: value read is out of the range of representable values");
-        return false;
-    }
-
-    ctx->cur = end;
-    return true;
+    return istr__get_uint(ctx, UINT64_MAX, val, "istrGetU64");
 }
 
 bool istrGetI8(instream_t *ctx, int8 *val) {
-    char *end = NULL;
-    *val = (int8) strtol(ctx->cur, &end, 0);
-    
-    if(ctx->cur == end) {
-        warn("istrGetI8: no valid conversion could be performed");
-        return false;
-    }
-    else if(*val == INT8_MAX || *val == INT8_MIN) {
-        warn("istrGetI8: value read is out of the range of representable values");
-        return false;
-    }
-
-    ctx->cur = end;
-    return true;
+    int64 out = 0;
+    bool ok = istr__get_int(ctx, INT8_MIN, INT8_MAX, &out, "istrGetI8");
+    *val = (int8)out;
+    return ok;
 }
 
 bool istrGetI16(instream_t *ctx, int16 *val) {
-    char *end = NULL;
-    *val = (int16) strtol(ctx->cur, &end, 0);
-    
-    if(ctx->cur == end) {
-        warn("istrGetI16: no valid conversion could be performed");
-        return false;
-    }
-    else if(*val == INT16_MAX || *val == INT16_MIN) {
-        warn("istrGetI16: value read is out of the range of representable values");
-        return false;
-    }
-
-    ctx->cur = end;
-    return true;
+    int64 out = 0;
+    bool ok = istr__get_int(ctx, INT16_MIN, INT16_MAX, &out, "istrGetI16");
+    *val = (int16)out;
+    return ok;
 }
 
 bool istrGetI32(instream_t *ctx, int32 *val) {
-    char *end = NULL;
-    *val = (int32) strtol(ctx->cur, &end, 0);
-    
-    if(ctx->cur == end) {
-        warn("istrGetI32: no valid conversion could be performed");
-        return false;
-    }
-    else if(*val == INT32_MAX || *val == INT32_MIN) {
-        warn("istrGetI32: value read is out of the range of representable values");
-        return false;
-    }
-
-    ctx->cur = end;
-    return true;
+    int64 out = 0;
+    bool ok = istr__get_int(ctx, INT32_MIN, INT32_MAX, &out, "istrGetI32");
+    *val = (int32)out;
+    return ok;
 }
 
 bool istrGetI64(instream_t *ctx, int64 *val) {
-    char *end = NULL;
-    *val = strtoll(ctx->cur, &end, 0);
-    
-    if(ctx->cur == end) {
-        warn("istrGetI64: no valid conversion could be performed");
-        return false;
-    }
-    else if(*val == INT64_MAX || *val == INT64_MIN) {
-        warn("istrGetI64: value read is out of the range of representable values");
-        return false;
-    }
-
-    ctx->cur = end;
-    return true;
+    return istr__get_int(ctx, INT64_MIN, INT64_MAX, val, "istrGetI64");
 }
 
 bool istrGetFloat(instream_t *ctx, float *val) {
-    char *end = NULL;
-    *val = strtof(ctx->cur, &end);
-    
-    if(ctx->cur == end) {
+    uint64 bits = 0;
+    const char *end = istr__get_float(ctx, &istr__f32, &bits);
+    if (!end) {
         warn("istrGetFloat: no valid conversion could be performed");
         return false;
     }
-    else if(*val == HUGE_VALF || *val == -HUGE_VALF) {
+
+    uint32 bits32 = (uint32)bits;
+    memcpy(val, &bits32, sizeof(*val));
+
+    if(*val == HUGE_VALF || *val == -HUGE_VALF) {
         warn("istrGetFloat: value read is out of the range of representable values");
         return false;
     }
@@ -277,14 +218,16 @@ bool istrGetFloat(instream_t *ctx, float *val) {
 }
 
 bool istrGetDouble(instream_t *ctx, double *val) {
-    char *end = NULL;
-    *val = strtod(ctx->cur, &end);
-    
-    if(ctx->cur == end) {
+    uint64 bits = 0;
+    const char *end = istr__get_float(ctx, &istr__f64, &bits);
+    if (!end) {
         warn("istrGetDouble: no valid conversion could be performed (%.5s)", ctx->cur);
         return false;
     }
-    else if(*val == HUGE_VAL || *val == -HUGE_VAL) {
+
+    memcpy(val, &bits, sizeof(*val));
+
+    if(*val == HUGE_VAL || *val == -HUGE_VAL) {
         warn("istrGetDouble: value read is out of the range of representable values");
         return false;
     }
@@ -328,8 +271,10 @@ strview_t istrGetView(instream_t *ctx, char delim) {
 
 strview_t istrGetViewEither(instream_t *ctx, strview_t chars) {
     const char *from = ctx->cur;
-    for (; !istrIsFinished(*ctx) && !strvContains(chars, *ctx->cur); ++ctx->cur) {
-
+    if (!istrIsFinished(*ctx)) {
+        usize remaining = istrRemaining(*ctx);
+        usize pos = strvFindEither(strvInitLen(ctx->cur, remaining), chars, 0);
+        ctx->cur += pos == STR_NONE ? remaining : pos;
     }
     usize len = ctx->cur - from;
     return strvInitLen(from, len);
@@ -352,6 +297,9 @@ void ostr__remove_null(outstream_t *o) {
 }
 
 outstream_t ostrInit(arena_t *arena) {
+    // the stream is everything between beg and the arena's current position, a chained arena
+    // can move to a new block in the middle of it
+    assert(!arena || arena->type != ARENA_CHAINED);
     return (outstream_t){
         .beg = (char *)(arena ? arena->current : NULL),
         .arena = arena,
@@ -419,16 +367,250 @@ void ostrAppendBool(outstream_t *ctx, bool val) {
     ostrPuts(ctx, val ? strv("true") : strv("false"));
 }
 
+// numbers are written straight into the arena, then the unused space is given back
+static char *ostr__num_begin(outstream_t *ctx) {
+    if (!ctx->arena) return NULL;
+    ostr__remove_null(ctx);
+    return alloc(ctx->arena, char, OSTR_NUM_MAX + 1, ALLOC_NOZERO);
+}
+
+static void ostr__num_end(outstream_t *ctx, char *buf, usize len) {
+    buf[len] = '\0';
+    arenaPop(ctx->arena, OSTR_NUM_MAX - len);
+}
+
 void ostrAppendUInt(outstream_t *ctx, uint64 val) {
-    ostrPrintf(ctx, "%I64u", val);
+    char *buf = ostr__num_begin(ctx);
+    if (!buf) return;
+    ostr__num_end(ctx, buf, ostr__format_uint(buf, val));
 }
 
 void ostrAppendInt(outstream_t *ctx, int64 val) {
-    ostrPrintf(ctx, "%I64d", val);
+    char *buf = ostr__num_begin(ctx);
+    if (!buf) return;
+    ostr__num_end(ctx, buf, ostr__format_int(buf, val));
 }
 
+// shortest representation that reads back as the same double,
+// integers below 1e15 are written in full, everything else like %g
 void ostrAppendNum(outstream_t *ctx, double val) {
-    ostrPrintf(ctx, "%g", val);
+    char *buf = ostr__num_begin(ctx);
+    if (!buf) return;
+    ostr__num_end(ctx, buf, ostr__format_double(buf, val));
+}
+
+usize ostrSink(void *userdata, const void *buf, usize len) {
+    ostrPuts(userdata, (strview_t){ buf, len });
+    return len;
+}
+
+/* == BUFFERED OUTPUT STREAM ================================== */
+
+obufstream_t obufInit(arena_t *exclusive_arena, usize capacity) {
+    if (!exclusive_arena) return (obufstream_t){0};
+    char *buf = alloc(exclusive_arena, char, capacity, ALLOC_NOZERO);
+    return (obufstream_t){
+        .beg = buf,
+        .cur = buf,
+        .end = buf + capacity,
+        .arena = exclusive_arena,
+    };
+}
+
+obufstream_t obufInitSink(arena_t *arena, usize capacity, obufsink_fn *sink, void *userdata) {
+    obufstream_t ctx = obufInit(arena, capacity);
+    ctx.sink = sink;
+    ctx.userdata = userdata;
+    return ctx;
+}
+
+static bool obuf__grow(obufstream_t *ctx, usize len) {
+    if (!ctx->arena || ctx->failed) {
+        return false;
+    }
+
+    usize used = ctx->cur - ctx->beg;
+    usize capacity = ctx->end - ctx->beg;
+
+    if (ctx->sink) {
+        if (!obufFlush(ctx)) {
+            return false;
+        }
+        if (len <= capacity) {
+            return true;
+        }
+        // a single reserve bigger than the whole buffer, the old one is left in the arena
+        char *buf = alloc(ctx->arena, char, len, ALLOC_NOZERO);
+        ctx->beg = ctx->cur = buf;
+        ctx->end = buf + len;
+        return true;
+    }
+
+    usize needed = len - (ctx->end - ctx->cur);
+    usize grow = needed > capacity ? needed : capacity;
+    char *more = alloc(ctx->arena, char, grow, ALLOC_NOZERO);
+    if (more != ctx->end) {
+        // the arena moved to a new block, bring everything along
+        char *moved = alloc(ctx->arena, char, used + len, ALLOC_NOZERO);
+        memcpy(moved, ctx->beg, used);
+        ctx->beg = moved;
+        ctx->cur = moved + used;
+        ctx->end = moved + used + len;
+        return true;
+    }
+    ctx->end += grow;
+    return true;
+}
+
+char *obufReserve(obufstream_t *ctx, usize len) {
+    if ((usize)(ctx->end - ctx->cur) < len && !obuf__grow(ctx, len)) {
+        return NULL;
+    }
+    return ctx->cur;
+}
+
+void obufCommit(obufstream_t *ctx, usize len) {
+    assert(ctx->cur + len <= ctx->end);
+    ctx->cur += len;
+}
+
+bool obufFlush(obufstream_t *ctx) {
+    if (!ctx->sink || ctx->cur == ctx->beg) {
+        return !ctx->failed;
+    }
+    if (ctx->failed) {
+        return false;
+    }
+
+    usize len = ctx->cur - ctx->beg;
+    usize written = ctx->sink(ctx->userdata, ctx->beg, len);
+    ctx->flushed += written;
+    ctx->cur = ctx->beg;
+
+    if (written != len) {
+        err("buffered stream sink only wrote %zu out of %zu bytes", written, len);
+        ctx->failed = true;
+    }
+
+    return !ctx->failed;
+}
+
+usize obufTell(obufstream_t *ctx) {
+    return ctx->flushed + (ctx->cur - ctx->beg);
+}
+
+str_t obufAsStr(obufstream_t *ctx) {
+    char *term = obufReserve(ctx, 1);
+    if (!term) return (str_t){0};
+    *term = '\0';
+
+    // give back the unused capacity if nothing else was allocated after it
+    if (!ctx->sink && ctx->arena->current == (uint8 *)ctx->end) {
+        arenaPop(ctx->arena, ctx->end - (term + 1));
+        ctx->end = term + 1;
+    }
+
+    return (str_t){ .buf = ctx->beg, .len = ctx->cur - ctx->beg };
+}
+
+strview_t obufAsView(obufstream_t *ctx) {
+    return (strview_t){ .buf = ctx->beg, .len = ctx->cur - ctx->beg };
+}
+
+void obufWrite(obufstream_t *ctx, const void *buf, usize len) {
+    if ((usize)(ctx->end - ctx->cur) >= len) {
+        memcpy(ctx->cur, buf, len);
+        ctx->cur += len;
+        return;
+    }
+
+    // too big for the buffer, skip the copy and hand it straight to the sink
+    if (ctx->sink && len >= (usize)(ctx->end - ctx->beg)) {
+        if (!obufFlush(ctx)) return;
+        usize written = ctx->sink(ctx->userdata, buf, len);
+        ctx->flushed += written;
+        if (written != len) {
+            err("buffered stream sink only wrote %zu out of %zu bytes", written, len);
+            ctx->failed = true;
+        }
+        return;
+    }
+
+    char *dst = obufReserve(ctx, len);
+    if (!dst) return;
+    memcpy(dst, buf, len);
+    ctx->cur += len;
+}
+
+void obufWriteMany(obufstream_t *ctx, const strview_t *views, usize count) {
+    usize total = 0;
+    for (usize i = 0; i < count; ++i) {
+        total += views[i].len;
+    }
+
+    bool fits = !ctx->sink || total <= (usize)(ctx->end - ctx->beg);
+    char *dst = fits ? obufReserve(ctx, total) : NULL;
+    if (!dst) {
+        for (usize i = 0; i < count; ++i) {
+            obufWrite(ctx, views[i].buf, views[i].len);
+        }
+        return;
+    }
+
+    for (usize i = 0; i < count; ++i) {
+        memcpy(dst, views[i].buf, views[i].len);
+        dst += views[i].len;
+    }
+    ctx->cur = dst;
+}
+
+void obufPutc(obufstream_t *ctx, char c) {
+    if (ctx->cur == ctx->end && !obuf__grow(ctx, 1)) {
+        return;
+    }
+    *ctx->cur++ = c;
+}
+
+void obufPuts(obufstream_t *ctx, strview_t v) {
+    obufWrite(ctx, v.buf, v.len);
+}
+
+void obufPrintf(obufstream_t *ctx, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    obufPrintfV(ctx, fmt, args);
+    va_end(args);
+}
+
+static char *obuf__fmt_callback(const char *buf, void *userdata, int len) {
+    (void)buf;
+    obufstream_t *ctx = userdata;
+    ctx->cur += len;
+    return obufReserve(ctx, FMT_CHUNK_SIZE);
+}
+
+void obufPrintfV(obufstream_t *ctx, const char *fmt, va_list args) {
+    char *buf = obufReserve(ctx, FMT_CHUNK_SIZE);
+    if (!buf) return;
+    fmtCallbackv(obuf__fmt_callback, ctx, buf, fmt, args);
+}
+
+void obufAppendUInt(obufstream_t *ctx, uint64 val) {
+    char *buf = obufReserve(ctx, OSTR_NUM_MAX);
+    if (!buf) return;
+    ctx->cur += ostr__format_uint(buf, val);
+}
+
+void obufAppendInt(obufstream_t *ctx, int64 val) {
+    char *buf = obufReserve(ctx, OSTR_NUM_MAX);
+    if (!buf) return;
+    ctx->cur += ostr__format_int(buf, val);
+}
+
+void obufAppendNum(obufstream_t *ctx, double val) {
+    char *buf = obufReserve(ctx, OSTR_NUM_MAX);
+    if (!buf) return;
+    ctx->cur += ostr__format_double(buf, val);
 }
 
 /* == OUT BYTE STREAM ========================================= */
@@ -604,4 +786,981 @@ strview_t ibstrGetView(ibytestream_t *ctx, usize lensize) {
     };
 }
 
+/* == NUMBERS ================================================= */
+
+// numbers never go through the c library, so they don't depend on the locale and never
+// read past the end of the stream. floats are parsed into up to 19 significant digits
+// and a power of ten, then converted with (in order of cost):
+//  - clinger's fast path, exact when both the digits and the power of ten fit in a float
+//  - eisel-lemire, a 64x128 bit multiplication that's correctly rounded whenever it succeeds
+//  - a big decimal that is shifted around until the mantissa falls out, exact but slow
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define ISTR_SWAR 0
+#else
+#define ISTR_SWAR 1
+#endif
+
+#define ISTR_MAX_DIGITS 19
+
+static inline bool istr__is_digit(char c) {
+    return (uchar)(c - '0') < 10;
+}
+
+static inline uint64 istr__read8(const char *p) {
+    uint64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// true if all 8 bytes are between '0' and '9'
+static inline bool istr__is_8_digits(uint64 v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+// turns 8 ascii digits (first digit in the lowest byte) into their value with 3 multiplications
+static inline uint32 istr__parse_8_digits(uint64 v) {
+    const uint64 mask = 0x000000FF000000FFull;
+    const uint64 mul1 = 0x000F424000000064ull; // 100 + (1000000 << 32)
+    const uint64 mul2 = 0x0000271000000001ull; // 1 + (10000 << 32)
+    v -= 0x3030303030303030ull;
+    v = (v * 10) + (v >> 8);
+    v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+    return (uint32)v;
+}
+
+static inline int istr__clz64(uint64 v) {
+#if COLLA_MSVC
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return 63 - (int)index;
+#elif COLLA_TCC
+    int n = 0;
+    while (!(v & (1ull << 63))) {
+        v <<= 1;
+        n++;
+    }
+    return n;
+#else
+    return __builtin_clzll(v);
+#endif
+}
+
+// returns the high 64 bits of a * b, the low ones go in lo
+static inline uint64 istr__mul128(uint64 a, uint64 b, uint64 *lo) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)a * b;
+    *lo = (uint64)r;
+    return (uint64)(r >> 64);
+#elif COLLA_MSVC && defined(_M_X64)
+    uint64 hi;
+    *lo = _umul128(a, b, &hi);
+    return hi;
+#else
+    uint64 a_lo = (uint32)a, a_hi = a >> 32;
+    uint64 b_lo = (uint32)b, b_hi = b >> 32;
+    uint64 lo_lo = a_lo * b_lo;
+    uint64 hi_lo = a_hi * b_lo;
+    uint64 lo_hi = a_lo * b_hi;
+    uint64 hi_hi = a_hi * b_hi;
+    uint64 cross = (lo_lo >> 32) + (uint32)hi_lo + lo_hi;
+    *lo = (cross << 32) | (uint32)lo_lo;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// == integers ==
+
+// base 10, or base 16 with a 0x prefix. returns the end of the number, NULL if there are no digits
+static const char *istr__scan_uint(const char *p, const char *end, uint64 *out, bool *overflow) {
+    uint64 value = 0;
+    *overflow = false;
+
+    if ((end - p) > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && isxdigit((uchar)p[2])) {
+        p += 2;
+        for (; p < end && isxdigit((uchar)*p); ++p) {
+            int digit = istr__is_digit(*p) ? *p - '0' : (tolower((uchar)*p) - 'a' + 10);
+            if (value >> 60) {
+                *overflow = true;
+            }
+            value = (value << 4) | digit;
+        }
+        *out = value;
+        return p;
+    }
+
+    const char *start = p;
+
+#if ISTR_SWAR
+    // 19 digits always fit, so the first two blocks of 8 never need an overflow check
+    while ((end - p) >= 8 && (p - start) <= 8) {
+        uint64 chunk = istr__read8(p);
+        if (!istr__is_8_digits(chunk)) {
+            break;
+        }
+        value = value * 100000000 + istr__parse_8_digits(chunk);
+        p += 8;
+    }
+#endif
+
+    for (; p < end && istr__is_digit(*p); ++p) {
+        uint64 digit = *p - '0';
+        if (value > (UINT64_MAX - digit) / 10) {
+            *overflow = true;
+        }
+        value = value * 10 + digit;
+    }
+
+    if (p == start) {
+        return NULL;
+    }
+
+    *out = value;
+    return p;
+}
+
+static const char *istr__skip_space(instream_t *ctx) {
+    const char *p = ctx->cur;
+    const char *end = ctx->start + ctx->size;
+    while (p < end && isspace((uchar)*p)) {
+        ++p;
+    }
+    return p;
+}
+
+static bool istr__get_uint(instream_t *ctx, uint64 max, uint64 *val, const char *name) {
+    const char *p = istr__skip_space(ctx);
+    const char *end = ctx->start + ctx->size;
+    if (p < end && *p == '+') {
+        ++p;
+    }
+
+    bool overflow = false;
+    const char *num_end = istr__scan_uint(p, end, val, &overflow);
+    if (!num_end) {
+        warn("%s: no valid conversion could be performed", name);
+        return false;
+    }
+    if (overflow || *val > max) {
+        warn("%s: value read is out of the range of representable values", name);
+        return false;
+    }
+
+    ctx->cur = num_end;
+    return true;
+}
+
+static bool istr__get_int(instream_t *ctx, int64 min, int64 max, int64 *val, const char *name) {
+    const char *p = istr__skip_space(ctx);
+    const char *end = ctx->start + ctx->size;
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64 magnitude = 0;
+    bool overflow = false;
+    const char *num_end = istr__scan_uint(p, end, &magnitude, &overflow);
+    if (!num_end) {
+        warn("%s: no valid conversion could be performed", name);
+        return false;
+    }
+
+    uint64 limit = negative ? (uint64)(-(min + 1)) + 1 : (uint64)max;
+    if (overflow || magnitude > limit) {
+        warn("%s: value read is out of the range of representable values", name);
+        return false;
+    }
+
+    *val = negative ? (int64)(0 - magnitude) : (int64)magnitude;
+    ctx->cur = num_end;
+    return true;
+}
+
+// == floats ==
+
+typedef struct {
+    uint64 mantissa;
+    int64 exp10;
+    bool negative;
+    // there were more than ISTR_MAX_DIGITS significant digits, the value is
+    // between mantissa * 10^exp10 and (mantissa + 1) * 10^exp10
+    bool truncated;
+} istr__number_t;
+
+// returns the end of the number, NULL if it doesn't start with one
+static const char *istr__scan_float(const char *p, const char *end, istr__number_t *num) {
+    *num = (istr__number_t){0};
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        num->negative = *p == '-';
+        ++p;
+    }
+
+    uint64 mantissa = 0;
+    int digits = 0;
+    int64 exp10 = 0;
+    bool any_digit = false;
+
+    // integer part
+    for (; p < end && istr__is_digit(*p); ++p) {
+        any_digit = true;
+        if (digits == 0 && *p == '0') {
+            continue;
+        }
+#if ISTR_SWAR
+        if (digits + 8 <= ISTR_MAX_DIGITS && (end - p) >= 8 && istr__is_8_digits(istr__read8(p))) {
+            mantissa = mantissa * 100000000 + istr__parse_8_digits(istr__read8(p));
+            digits += 8;
+            p += 7;
+            continue;
+        }
+#endif
+        if (digits < ISTR_MAX_DIGITS) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+        }
+        else {
+            exp10++;
+            num->truncated |= *p != '0';
+        }
+    }
+
+    // fraction
+    if (p < end && *p == '.') {
+        ++p;
+        for (; p < end && istr__is_digit(*p); ++p) {
+            any_digit = true;
+            if (digits == 0 && *p == '0') {
+                exp10--;
+                continue;
+            }
+#if ISTR_SWAR
+            if (digits + 8 <= ISTR_MAX_DIGITS && (end - p) >= 8 && istr__is_8_digits(istr__read8(p))) {
+                mantissa = mantissa * 100000000 + istr__parse_8_digits(istr__read8(p));
+                digits += 8;
+                exp10 -= 8;
+                p += 7;
+                continue;
+            }
+#endif
+            if (digits < ISTR_MAX_DIGITS) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits++;
+                exp10--;
+            }
+            else {
+                num->truncated |= *p != '0';
+            }
+        }
+    }
+
+    if (!any_digit) {
+        return NULL;
+    }
+
+    // exponent, only consumed if there is at least one digit after it
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        bool negative_exp = false;
+        if (e < end && (*e == '+' || *e == '-')) {
+            negative_exp = *e == '-';
+            ++e;
+        }
+        if (e < end && istr__is_digit(*e)) {
+            int64 exp = 0;
+            for (; e < end && istr__is_digit(*e); ++e) {
+                // anything bigger is already zero or infinity
+                if (exp < 100000) {
+                    exp = exp * 10 + (*e - '0');
+                }
+            }
+            exp10 += negative_exp ? -exp : exp;
+            p = e;
+        }
+    }
+
+    num->mantissa = mantissa;
+    num->exp10 = exp10;
+    return p;
+}
+
+static bool istr__clinger(const istr__number_t *num, const istr__float_info_t *info, uint64 *bits) {
+    static const double pow10_f64[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    static const float pow10_f32[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+    };
+
+    if (num->truncated) {
+        return false;
+    }
+
+    if (info == &istr__f64) {
+        if (num->mantissa > (1ull << 53) || num->exp10 < -22 || num->exp10 > 22) {
+            return false;
+        }
+        double value = (double)num->mantissa;
+        value = num->exp10 < 0 ? value / pow10_f64[-num->exp10] : value * pow10_f64[num->exp10];
+        if (num->negative) value = -value;
+        memcpy(bits, &value, sizeof(value));
+        return true;
+    }
+
+    if (num->mantissa > (1ull << 24) || num->exp10 < -10 || num->exp10 > 10) {
+        return false;
+    }
+    float value = (float)num->mantissa;
+    value = num->exp10 < 0 ? value / pow10_f32[-num->exp10] : value * pow10_f32[num->exp10];
+    if (num->negative) value = -value;
+    uint32 bits32;
+    memcpy(&bits32, &value, sizeof(value));
+    *bits = bits32;
+    return true;
+}
+
+// https://arxiv.org/abs/2101.11408, fails when the result can't be rounded with certainty
+static bool istr__eisel_lemire(uint64 mantissa, int64 exp10, bool negative, const istr__float_info_t *info, uint64 *bits) {
+    if (mantissa == 0) {
+        *bits = (uint64)negative << (info->mant_bits + info->exp_bits);
+        return true;
+    }
+
+    if (exp10 < ISTR_POW10_MIN || exp10 > ISTR_POW10_MAX) {
+        return false;
+    }
+
+    const uint64 *pow10 = istr__pow10_table[exp10 - ISTR_POW10_MIN];
+    int extra_bits = 64 - info->mant_bits - 3;
+    uint64 low_mask = (1ull << extra_bits) - 1;
+
+    int clz = istr__clz64(mantissa);
+    mantissa <<= clz;
+    uint64 exp2 = (uint64)(((217706 * exp10) >> 16) + 64 - info->bias) - clz;
+
+    uint64 x_lo;
+    uint64 x_hi = istr__mul128(mantissa, pow10[1], &x_lo);
+
+    // the bits that decide the rounding might be wrong, use the low half of the power too
+    if ((x_hi & low_mask) == low_mask && x_lo + mantissa < mantissa) {
+        uint64 y_lo;
+        uint64 y_hi = istr__mul128(mantissa, pow10[0], &y_lo);
+        uint64 merged_hi = x_hi, merged_lo = x_lo + y_hi;
+        if (merged_lo < x_lo) {
+            merged_hi++;
+        }
+        if ((merged_hi & low_mask) == low_mask && merged_lo + 1 == 0 && y_lo + mantissa < mantissa) {
+            return false;
+        }
+        x_hi = merged_hi;
+        x_lo = merged_lo;
+    }
+
+    uint64 msb = x_hi >> 63;
+    uint64 result = x_hi >> (msb + extra_bits);
+    exp2 -= 1 ^ msb;
+
+    // exactly halfway between two floats
+    if (x_lo == 0 && (x_hi & low_mask) == 0 && (result & 3) == 1) {
+        return false;
+    }
+
+    result += result & 1;
+    result >>= 1;
+    if (result >> (info->mant_bits + 1)) {
+        result >>= 1;
+        exp2++;
+    }
+
+    // subnormals, infinity and nan go through the slow path
+    uint64 max_exp = (1ull << info->exp_bits) - 1;
+    if (exp2 - 1 >= max_exp - 1) {
+        return false;
+    }
+
+    *bits = exp2 << info->mant_bits | (result & ((1ull << info->mant_bits) - 1));
+    *bits |= (uint64)negative << (info->mant_bits + info->exp_bits);
+    return true;
+}
+
+// == big decimal, the same algorithm as go's strconv ==
+
+#define ISTR_DECIMAL_DIGITS 800
+// the biggest shift that can't overflow the accumulator
+#define ISTR_DECIMAL_MAX_SHIFT 60
+
+typedef struct {
+    uchar digits[ISTR_DECIMAL_DIGITS];
+    int count;
+    int point;
+    bool negative;
+    bool truncated;
+} istr__decimal_t;
+
+static void istr__decimal_trim(istr__decimal_t *d) {
+    while (d->count > 0 && d->digits[d->count - 1] == 0) {
+        d->count--;
+    }
+    if (d->count == 0) {
+        d->point = 0;
+    }
+}
+
+static void istr__decimal_set(istr__decimal_t *d, const char *p, const char *end) {
+    d->count = d->point = 0;
+    d->negative = d->truncated = false;
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        d->negative = *p == '-';
+        ++p;
+    }
+
+    bool seen_point = false;
+    for (; p < end; ++p) {
+        if (*p == '.' && !seen_point) {
+            seen_point = true;
+            d->point = d->count;
+            continue;
+        }
+        if (!istr__is_digit(*p)) {
+            break;
+        }
+        if (*p == '0' && d->count == 0) {
+            d->point--;
+            continue;
+        }
+        if (d->count < ISTR_DECIMAL_DIGITS) {
+            d->digits[d->count++] = *p - '0';
+        }
+        else if (*p != '0') {
+            d->truncated = true;
+        }
+    }
+
+    if (!seen_point) {
+        d->point = d->count;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        int sign = 1;
+        if (p < end && (*p == '+' || *p == '-')) {
+            sign = *p == '-' ? -1 : 1;
+            ++p;
+        }
+        int exp = 0;
+        for (; p < end && istr__is_digit(*p); ++p) {
+            if (exp < 10000) {
+                exp = exp * 10 + (*p - '0');
+            }
+        }
+        d->point += exp * sign;
+    }
+
+    istr__decimal_trim(d);
+}
+
+static void istr__decimal_right_shift(istr__decimal_t *d, int shift) {
+    int read = 0, write = 0;
+    uint64 n = 0;
+
+    for (; (n >> shift) == 0; ++read) {
+        if (read >= d->count) {
+            if (n == 0) {
+                d->count = 0;
+                return;
+            }
+            while ((n >> shift) == 0) {
+                n *= 10;
+                read++;
+            }
+            break;
+        }
+        n = n * 10 + d->digits[read];
+    }
+
+    d->point -= read - 1;
+
+    uint64 mask = (1ull << shift) - 1;
+    for (; read < d->count; ++read) {
+        uchar c = d->digits[read];
+        d->digits[write++] = (uchar)(n >> shift);
+        n = (n & mask) * 10 + c;
+    }
+
+    while (n > 0) {
+        uchar digit = (uchar)(n >> shift);
+        n &= mask;
+        if (write < ISTR_DECIMAL_DIGITS) {
+            d->digits[write++] = digit;
+        }
+        else if (digit > 0) {
+            d->truncated = true;
+        }
+        n *= 10;
+    }
+
+    d->count = write;
+    istr__decimal_trim(d);
+}
+
+static void istr__decimal_left_shift(istr__decimal_t *d, int shift) {
+    // the new digits are written from the right, so it's easier to not know how many there will be
+    uchar tmp[ISTR_DECIMAL_DIGITS + 20];
+    int write = (int)sizeof(tmp);
+    uint64 n = 0;
+
+    for (int read = d->count - 1; read >= 0; --read) {
+        n += (uint64)d->digits[read] << shift;
+        tmp[--write] = (uchar)(n % 10);
+        n /= 10;
+    }
+
+    while (n > 0) {
+        tmp[--write] = (uchar)(n % 10);
+        n /= 10;
+    }
+
+    int new_count = (int)sizeof(tmp) - write;
+    d->point += new_count - d->count;
+
+    if (new_count > ISTR_DECIMAL_DIGITS) {
+        for (int i = ISTR_DECIMAL_DIGITS; i < new_count; ++i) {
+            d->truncated |= tmp[write + i] != 0;
+        }
+        new_count = ISTR_DECIMAL_DIGITS;
+    }
+
+    memcpy(d->digits, tmp + write, new_count);
+    d->count = new_count;
+    istr__decimal_trim(d);
+}
+
+static void istr__decimal_shift(istr__decimal_t *d, int shift) {
+    if (d->count == 0) {
+        return;
+    }
+    for (; shift > ISTR_DECIMAL_MAX_SHIFT; shift -= ISTR_DECIMAL_MAX_SHIFT) {
+        istr__decimal_left_shift(d, ISTR_DECIMAL_MAX_SHIFT);
+    }
+    for (; shift < -ISTR_DECIMAL_MAX_SHIFT; shift += ISTR_DECIMAL_MAX_SHIFT) {
+        istr__decimal_right_shift(d, ISTR_DECIMAL_MAX_SHIFT);
+    }
+    if (shift > 0) istr__decimal_left_shift(d, shift);
+    if (shift < 0) istr__decimal_right_shift(d, -shift);
+}
+
+static bool istr__decimal_round_up(istr__decimal_t *d, int at) {
+    if (at < 0 || at >= d->count) {
+        return false;
+    }
+    // exactly halfway, round to even
+    if (d->digits[at] == 5 && at + 1 == d->count) {
+        if (d->truncated) {
+            return true;
+        }
+        return at > 0 && (d->digits[at - 1] % 2) == 1;
+    }
+    return d->digits[at] >= 5;
+}
+
+static uint64 istr__decimal_rounded_integer(istr__decimal_t *d) {
+    if (d->point > 20) {
+        return UINT64_MAX;
+    }
+    uint64 n = 0;
+    int i = 0;
+    for (; i < d->point && i < d->count; ++i) {
+        n = n * 10 + d->digits[i];
+    }
+    for (; i < d->point; ++i) {
+        n *= 10;
+    }
+    if (istr__decimal_round_up(d, d->point)) {
+        n++;
+    }
+    return n;
+}
+
+static uint64 istr__decimal_to_bits(istr__decimal_t *d, const istr__float_info_t *info) {
+    // shifts that move the point by at least that many digits, indexed by the digits to move
+    static const int pow2_for_digits[] = { 1, 3, 6, 9, 13, 16, 19, 23, 26 };
+    const int max_pow = 27;
+
+    uint64 sign = (uint64)d->negative << (info->mant_bits + info->exp_bits);
+    uint64 inf = (((1ull << info->exp_bits) - 1) << info->mant_bits) | sign;
+    int exp = 0;
+    uint64 mantissa = 0;
+
+    if (d->count == 0 || d->point < -330) {
+        return sign;
+    }
+    if (d->point > 310) {
+        return inf;
+    }
+
+    // scale by powers of two until the number is in [0.5, 1)
+    while (d->point > 0) {
+        int n = d->point >= (int)arrlen(pow2_for_digits) ? max_pow : pow2_for_digits[d->point];
+        istr__decimal_shift(d, -n);
+        exp += n;
+    }
+    while (d->point < 0 || (d->point == 0 && d->digits[0] < 5)) {
+        int n = -d->point >= (int)arrlen(pow2_for_digits) ? max_pow : pow2_for_digits[-d->point];
+        istr__decimal_shift(d, n);
+        exp -= n;
+    }
+
+    // [0.5, 1) to [1, 2)
+    exp--;
+
+    // subnormals have the smallest exponent and fewer bits of precision
+    if (exp < info->bias + 1) {
+        int n = info->bias + 1 - exp;
+        istr__decimal_shift(d, -n);
+        exp += n;
+    }
+
+    if (exp - info->bias >= (1 << info->exp_bits) - 1) {
+        return inf;
+    }
+
+    istr__decimal_shift(d, 1 + info->mant_bits);
+    mantissa = istr__decimal_rounded_integer(d);
+
+    // rounding might have carried into a new bit
+    if (mantissa == (2ull << info->mant_bits)) {
+        mantissa >>= 1;
+        exp++;
+        if (exp - info->bias >= (1 << info->exp_bits) - 1) {
+            return inf;
+        }
+    }
+
+    if ((mantissa & (1ull << info->mant_bits)) == 0) {
+        exp = info->bias;
+    }
+
+    uint64 exp_bits = (uint64)((exp - info->bias) & ((1 << info->exp_bits) - 1));
+    return (mantissa & ((1ull << info->mant_bits) - 1)) | (exp_bits << info->mant_bits) | sign;
+}
+
+static bool istr__match_nocase(const char *p, const char *end, const char *word) {
+    for (; *word; ++word, ++p) {
+        if (p >= end || tolower((uchar)*p) != *word) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char *istr__get_float(instream_t *ctx, const istr__float_info_t *info, uint64 *bits) {
+    const char *p = istr__skip_space(ctx);
+    const char *end = ctx->start + ctx->size;
+
+    istr__number_t num;
+    const char *num_end = istr__scan_float(p, end, &num);
+
+    if (!num_end) {
+        // inf, infinity and nan, like strtod
+        const char *word = p + (p < end && (*p == '+' || *p == '-'));
+        uint64 sign = (uint64)(p < end && *p == '-') << (info->mant_bits + info->exp_bits);
+        uint64 exp_all = ((1ull << info->exp_bits) - 1) << info->mant_bits;
+        if (istr__match_nocase(word, end, "inf")) {
+            *bits = exp_all | sign;
+            return word + (istr__match_nocase(word, end, "infinity") ? 8 : 3);
+        }
+        if (istr__match_nocase(word, end, "nan")) {
+            *bits = exp_all | (1ull << (info->mant_bits - 1)) | sign;
+            return word + 3;
+        }
+        return NULL;
+    }
+
+    if (istr__clinger(&num, info, bits)) {
+        return num_end;
+    }
+
+    if (istr__eisel_lemire(num.mantissa, num.exp10, num.negative, info, bits)) {
+        // with truncated digits the result has to be the same for both ends of the interval
+        uint64 upper;
+        if (!num.truncated || (istr__eisel_lemire(num.mantissa + 1, num.exp10, num.negative, info, &upper) && upper == *bits)) {
+            return num_end;
+        }
+    }
+
+    istr__decimal_t decimal;
+    istr__decimal_set(&decimal, p, num_end);
+    *bits = istr__decimal_to_bits(&decimal, info);
+    return num_end;
+}
+
+/* == NUMBER FORMATTING ======================================= */
+
+static const char ostr__digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static int ostr__count_digits(uint64 val) {
+    int count = 1;
+    for (;;) {
+        if (val < 10)    return count;
+        if (val < 100)   return count + 1;
+        if (val < 1000)  return count + 2;
+        if (val < 10000) return count + 3;
+        val /= 10000;
+        count += 4;
+    }
+}
+
+// two digits at a time from the end, the length is known in advance so it's written in place
+static usize ostr__format_uint(char *buf, uint64 val) {
+    int len = ostr__count_digits(val);
+    char *p = buf + len;
+
+    while (val >= 100) {
+        uint64 pair = (val % 100) * 2;
+        val /= 100;
+        *--p = ostr__digit_pairs[pair + 1];
+        *--p = ostr__digit_pairs[pair];
+    }
+
+    if (val >= 10) {
+        *--p = ostr__digit_pairs[val * 2 + 1];
+        *--p = ostr__digit_pairs[val * 2];
+    }
+    else {
+        *--p = (char)('0' + val);
+    }
+
+    return len;
+}
+
+static usize ostr__format_int(char *buf, int64 val) {
+    usize len = 0;
+    if (val < 0) {
+        buf[len++] = '-';
+    }
+    uint64 magnitude = val < 0 ? 0 - (uint64)val : (uint64)val;
+    return len + ostr__format_uint(buf + len, magnitude);
+}
+
+// grisu2 (loitsch, "printing floating-point numbers quickly and accurately with integers"),
+// the output always reads back as the same double and is the shortest one in almost every case
+
+typedef struct {
+    uint64 f;
+    int e;
+} ostr__fp_t;
+
+// the product exponent is kept in this range so the integral part fits in 32 bits
+#define OSTR_GRISU_ALPHA (-60)
+#define OSTR_GRISU_GAMMA (-32)
+
+static ostr__fp_t ostr__fp_mul(ostr__fp_t x, ostr__fp_t y) {
+    uint64 lo;
+    uint64 hi = istr__mul128(x.f, y.f, &lo);
+    // round to nearest
+    hi += lo >> 63;
+    return (ostr__fp_t){ hi, x.e + y.e + 64 };
+}
+
+static ostr__fp_t ostr__fp_normalize(ostr__fp_t x) {
+    int shift = istr__clz64(x.f);
+    return (ostr__fp_t){ x.f << shift, x.e - shift };
+}
+
+// 10^k rounded to 64 bits, from the same table the parser uses
+static ostr__fp_t ostr__cached_pow10(int k) {
+    const uint64 *pow10 = istr__pow10_table[k - ISTR_POW10_MIN];
+    // floor(log2(10^k)) - 63, the top bit of the table entry is the 2^127 one
+    return (ostr__fp_t){ pow10[1] + (pow10[0] >> 63), ((217706 * k) >> 16) - 63 };
+}
+
+static void ostr__grisu_round(char *buf, int len, uint64 dist, uint64 delta, uint64 rest, uint64 ten_k) {
+    // move the last digit down while it gets closer to the real value and stays inside the bounds
+    while (rest < dist && delta - rest >= ten_k && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+static int ostr__grisu_digits(char *buf, int *exp10, ostr__fp_t low, ostr__fp_t w, ostr__fp_t high) {
+    static const uint32 pow10[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+    };
+
+    uint64 delta = high.f - low.f;
+    uint64 dist = high.f - w.f;
+
+    ostr__fp_t one = { 1ull << -high.e, high.e };
+    uint32 integral = (uint32)(high.f >> -one.e);
+    uint64 fraction = high.f & (one.f - 1);
+
+    int len = 0;
+    int n = 10;
+    while (n > 1 && integral < pow10[n - 1]) {
+        n--;
+    }
+
+    while (n > 0) {
+        uint32 div = pow10[n - 1];
+        buf[len++] = (char)('0' + integral / div);
+        integral %= div;
+        n--;
+
+        uint64 rest = ((uint64)integral << -one.e) + fraction;
+        if (rest <= delta) {
+            *exp10 += n;
+            ostr__grisu_round(buf, len, dist, delta, rest, (uint64)div << -one.e);
+            return len;
+        }
+    }
+
+    int m = 0;
+    for (;;) {
+        fraction *= 10;
+        buf[len++] = (char)('0' + (fraction >> -one.e));
+        fraction &= one.f - 1;
+        m++;
+        delta *= 10;
+        dist *= 10;
+        if (fraction <= delta) {
+            break;
+        }
+    }
+
+    *exp10 -= m;
+    ostr__grisu_round(buf, len, dist, delta, fraction, one.f);
+    return len;
+}
+
+// writes the digits of a positive, finite, non zero double, value = digits * 10^exp10
+static int ostr__grisu2(char *buf, int *exp10, double val) {
+    const uint64 hidden = 1ull << 52;
+
+    uint64 bits;
+    memcpy(&bits, &val, sizeof(bits));
+    uint64 mantissa = bits & (hidden - 1);
+    int exponent = (int)(bits >> 52);
+
+    ostr__fp_t v = exponent == 0 ?
+        (ostr__fp_t){ mantissa, 1 - 1075 } :
+        (ostr__fp_t){ mantissa + hidden, exponent - 1075 };
+
+    // the halfway points to the neighbouring doubles, the lower one is closer at powers of two
+    bool lower_closer = mantissa == 0 && exponent > 1;
+    ostr__fp_t high = ostr__fp_normalize((ostr__fp_t){ v.f * 2 + 1, v.e - 1 });
+    ostr__fp_t low = lower_closer ?
+        (ostr__fp_t){ v.f * 4 - 1, v.e - 2 } :
+        (ostr__fp_t){ v.f * 2 - 1, v.e - 1 };
+    low.f <<= low.e - high.e;
+    low.e = high.e;
+    ostr__fp_t w = ostr__fp_normalize(v);
+
+    // smallest k with 10^k * 2^high.e * 2^64 >= 2^alpha
+    int f = OSTR_GRISU_ALPHA - high.e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    ostr__fp_t cached = ostr__cached_pow10(k);
+
+    w = ostr__fp_mul(w, cached);
+    low = ostr__fp_mul(low, cached);
+    high = ostr__fp_mul(high, cached);
+
+    // the multiplications are off by up to one ulp, stay on the safe side
+    low.f++;
+    high.f--;
+
+    *exp10 = -k;
+    return ostr__grisu_digits(buf, exp10, low, w, high);
+}
+
+static usize ostr__format_exponent(char *buf, int exp) {
+    usize len = 0;
+    buf[len++] = 'e';
+    buf[len++] = exp < 0 ? '-' : '+';
+    uint32 e = exp < 0 ? -exp : exp;
+    // at least two digits, like printf
+    if (e < 10) {
+        buf[len++] = '0';
+    }
+    len += ostr__format_uint(buf + len, e);
+    return len;
+}
+
+#define OSTR_FIXED_MIN_EXP (-4)
+#define OSTR_FIXED_MAX_EXP 15
+
+static usize ostr__format_double(char *buf, double val) {
+    uint64 bits;
+    memcpy(&bits, &val, sizeof(bits));
+
+    usize len = 0;
+    if (bits >> 63) {
+        buf[len++] = '-';
+        bits &= ~(1ull << 63);
+        memcpy(&val, &bits, sizeof(val));
+    }
+
+    if ((bits >> 52) == 0x7FF) {
+        const char *special = (bits & ((1ull << 52) - 1)) ? "nan" : "inf";
+        // -nan isn't a thing for %g either
+        if (special[0] == 'n') len = 0;
+        memcpy(buf + len, special, 3);
+        return len + 3;
+    }
+
+    if (bits == 0) {
+        buf[len++] = '0';
+        return len;
+    }
+
+    char *digits = buf + len;
+    int exp10 = 0;
+    int count = ostr__grisu2(digits, &exp10, val);
+    // position of the decimal point relative to the first digit
+    int point = count + exp10;
+
+    if (count <= point && point <= OSTR_FIXED_MAX_EXP) {
+        // 1234000
+        memset(digits + count, '0', point - count);
+        return len + point;
+    }
+
+    if (0 < point && point <= OSTR_FIXED_MAX_EXP) {
+        // 12.34
+        memmove(digits + point + 1, digits + point, count - point);
+        digits[point] = '.';
+        return len + count + 1;
+    }
+
+    if (OSTR_FIXED_MIN_EXP < point && point <= 0) {
+        // 0.001234
+        memmove(digits + 2 - point, digits, count);
+        digits[0] = '0';
+        digits[1] = '.';
+        memset(digits + 2, '0', -point);
+        return len + 2 - point + count;
+    }
+
+    // 1.234e+56
+    if (count == 1) {
+        return len + 1 + ostr__format_exponent(digits + 1, point - 1);
+    }
+    memmove(digits + 2, digits + 1, count - 1);
+    digits[1] = '.';
+    return len + count + 1 + ostr__format_exponent(digits + count + 1, point - 1);
+}
+
 #include "warnings/colla_warn_end.h"
\ No newline at end of file
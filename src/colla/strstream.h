@@ -78,6 +78,7 @@ typedef struct {
     arena_t *arena;
 } outstream_t;
 
+// the arena can't be ARENA_CHAINED
 outstream_t ostrInit(arena_t *exclusive_arena);
 void ostrClear(outstream_t *ctx);
 
@@ -97,6 +98,58 @@ void ostrAppendUInt(outstream_t *ctx, uint64 val);
 void ostrAppendInt(outstream_t *ctx, int64 val);
 void ostrAppendNum(outstream_t *ctx, double val);
 
+// obufsink_fn (see below), userdata is an outstream_t *, so a buffered stream can build a string
+usize ostrSink(void *userdata, const void *buf, usize len);
+
+/* == BUFFERED OUTPUT STREAM ================================== */
+
+// gets the full buffer when flushing, returns how many bytes were written
+typedef usize (obufsink_fn)(void *userdata, const void *buf, usize len);
+
+typedef struct {
+    char *beg;
+    char *cur;
+    char *end;
+    arena_t *arena;
+    obufsink_fn *sink;
+    void *userdata;
+    // bytes already given to the sink
+    usize flushed;
+    // set when the sink couldn't write everything, nothing else is written after
+    bool failed;
+} obufstream_t;
+
+// without a sink everything stays in the arena, the buffer grows in place when full
+obufstream_t obufInit(arena_t *exclusive_arena, usize capacity);
+// fixed buffer of capacity bytes, given to the sink every time it fills up
+obufstream_t obufInitSink(arena_t *arena, usize capacity, obufsink_fn *sink, void *userdata);
+
+// makes sure there are at least len free bytes after the cursor and returns it,
+// write into it and then move the cursor with obufCommit
+char *obufReserve(obufstream_t *ctx, usize len);
+void obufCommit(obufstream_t *ctx, usize len);
+// gives everything buffered to the sink, does nothing without a sink
+bool obufFlush(obufstream_t *ctx);
+
+// total bytes written, including the ones already flushed
+usize obufTell(obufstream_t *ctx);
+// what is currently buffered, without a sink that's everything.
+// null terminated, the unused capacity is given back to the arena
+str_t obufAsStr(obufstream_t *ctx);
+strview_t obufAsView(obufstream_t *ctx);
+
+void obufWrite(obufstream_t *ctx, const void *buf, usize len);
+// like writev, all the views are copied with a single reserve when they fit
+void obufWriteMany(obufstream_t *ctx, const strview_t *views, usize count);
+void obufPutc(obufstream_t *ctx, char c);
+void obufPuts(obufstream_t *ctx, strview_t v);
+void obufPrintf(obufstream_t *ctx, const char *fmt, ...);
+void obufPrintfV(obufstream_t *ctx, const char *fmt, va_list args);
+
+void obufAppendUInt(obufstream_t *ctx, uint64 val);
+void obufAppendInt(obufstream_t *ctx, int64 val);
+void obufAppendNum(obufstream_t *ctx, double val);
+
 /* == OUT BYTE STREAM ========================================= */
 
 typedef struct {
@@ -33,14 +33,19 @@ usize vmemPadToPage(usize byte_count) {
     return byte_count + padding;
 }
 
+void *vmemInit(usize size, usize *out_padded_size) {
+    return vmemReserve(size, out_padded_size, VMEM_FLAGS_NONE);
+}
+
 #if COLLA_WIN
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
-void *vmemInit(usize size, usize *out_padded_size) {
+void *vmemReserve(usize size, usize *out_padded_size, vmem_flags_e flags) {
+    // large pages have to be committed together with the reservation, so VMEM_HUGE_PAGES is ignored
+    (void)flags;
     usize alloc_size = vmemPadToPage(size);
-
     void *ptr = VirtualAlloc(NULL, alloc_size, MEM_RESERVE, PAGE_NOACCESS);
 
     if (out_padded_size) {
@@ -50,7 +55,8 @@ void *vmemInit(usize size, usize *out_padded_size) {
     return ptr;
 }
 
-bool vmemRelease(void *base_ptr) {
+bool vmemRelease(void *base_ptr, usize size) {
+    (void)size;
     return VirtualFree(base_ptr, 0, MEM_RELEASE);
 }
 
@@ -66,6 +72,25 @@ bool vmemCommit(void *ptr, usize num_of_pages) {
     return new_ptr != NULL;
 }
 
+void vmemPrefault(void *ptr, usize num_of_pages) {
+    usize page_size = vmemGetPageSize();
+    for (usize i = 0; i < num_of_pages; ++i) {
+        ((volatile byte *)ptr)[i * page_size] = 0;
+    }
+}
+
+bool vmemDecommit(void *ptr, usize num_of_pages) {
+    usize page_size = vmemGetPageSize();
+
+    BOOL success = VirtualFree(ptr, num_of_pages * page_size, MEM_DECOMMIT);
+
+    if (!success) {
+        debug("ERROR: failed to decommit memory: %lu\n", GetLastError());
+    }
+
+    return success;
+}
+
 static void vmem__update_page_size(void) {
     SYSTEM_INFO info = {0};
     GetSystemInfo(&info);
@@ -80,34 +105,46 @@ static void vmem__update_page_size(void) {
 #include <errno.h>
 #include <string.h>
 
-typedef struct {
-    usize len;
-} vmem__header;
-
-void *vmemInit(usize size, usize *out_padded_size) {
-    size += sizeof(vmem__header);
+void *vmemReserve(usize size, usize *out_padded_size, vmem_flags_e flags) {
     usize alloc_size = vmemPadToPage(size);
+    usize map_size = alloc_size;
 
-    vmem__header *header = mmap(NULL, alloc_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (flags & VMEM_HUGE_PAGES) {
+        // transparent huge pages only back 2MB aligned ranges, over map and trim
+        alloc_size = (alloc_size + VMEM_HUGE_PAGE_SIZE - 1) & ~((usize)VMEM_HUGE_PAGE_SIZE - 1);
+        map_size = alloc_size + VMEM_HUGE_PAGE_SIZE;
+    }
+
+    // only address space, pages get committed with mprotect
+    byte *ptr = mmap(NULL, map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
 
-    if (header == MAP_FAILED) {
+    if (ptr == MAP_FAILED) {
         fatal("could not map %zu memory: %s", size, strerror(errno));
     }
 
+    if (map_size != alloc_size) {
+        byte *aligned = (byte *)(((uintptr_t)ptr + VMEM_HUGE_PAGE_SIZE - 1) & ~((uintptr_t)VMEM_HUGE_PAGE_SIZE - 1));
+        usize head = aligned - ptr;
+        if (head) munmap(ptr, head);
+        munmap(aligned + alloc_size, map_size - head - alloc_size);
+        ptr = aligned;
+#ifdef MADV_HUGEPAGE
+        // the flag stays on the pages as they get committed
+        madvise(ptr, alloc_size, MADV_HUGEPAGE);
+#endif
+    }
+
     if (out_padded_size) {
         *out_padded_size = alloc_size;
     }
 
-    header->len = alloc_size;
-
-    return header + 1;
+    return ptr;
 }
 
-bool vmemRelease(void *base_ptr) {
+bool vmemRelease(void *base_ptr, usize size) {
     if (!base_ptr) return false;
-    vmem__header *header = (vmem__header *)base_ptr - 1;
 
-    int res = munmap(header, header->len);
+    int res = munmap(base_ptr, size);
     if (res == -1) {
         err("munmap failed: %s", strerror(errno));
     }
@@ -115,10 +152,40 @@ bool vmemRelease(void *base_ptr) {
 }
 
 bool vmemCommit(void *ptr, usize num_of_pages) {
-    // mmap doesn't need a commit step
-    (void)ptr;
-    (void)num_of_pages;
-    return true;
+    usize page_size = vmemGetPageSize();
+
+    int res = mprotect(ptr, num_of_pages * page_size, PROT_READ | PROT_WRITE);
+    if (res == -1) {
+        debug("ERROR: failed to commit memory: %s\n", strerror(errno));
+    }
+
+    return res != -1;
+}
+
+void vmemPrefault(void *ptr, usize num_of_pages) {
+    usize page_size = vmemGetPageSize();
+
+#ifdef MADV_POPULATE_WRITE
+    // a single syscall instead of a fault per page, only there since linux 5.14
+    if (madvise(ptr, num_of_pages * page_size, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+
+    for (usize i = 0; i < num_of_pages; ++i) {
+        ((volatile byte *)ptr)[i * page_size] = 0;
+    }
+}
+
+bool vmemDecommit(void *ptr, usize num_of_pages) {
+    usize page_size = vmemGetPageSize();
+
+    int res = madvise(ptr, num_of_pages * page_size, MADV_DONTNEED);
+    if (res == -1) {
+        debug("ERROR: failed to decommit memory: %s\n", strerror(errno));
+    }
+
+    return res != -1;
 }
 
 static void vmem__update_page_size(void) {
@@ -131,4 +198,4 @@ static void vmem__update_page_size(void) {
     vmem__page_size = (usize)lin_page_size;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -3,10 +3,30 @@
 
 #include "collatypes.h"
 
+typedef enum {
+    VMEM_FLAGS_NONE = 0,
+    // ask for huge pages as the memory gets committed: on linux the reservation is huge page
+    // aligned and marked for transparent huge pages, commit it in VMEM_HUGE_PAGE_SIZE steps so
+    // every step can be backed by one. windows large pages can only be committed all at once,
+    // so there this does nothing
+    VMEM_HUGE_PAGES = 1 << 0,
+} vmem_flags_e;
+
+#define VMEM_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// reserves address space, nothing can be read or written before it is committed
+void *vmemReserve(usize size, usize *out_padded_size, vmem_flags_e flags);
 void *vmemInit(usize size, usize *out_padded_size);
-bool vmemRelease(void *base_ptr);
+// size is the padded size returned by vmemReserve
+bool vmemRelease(void *base_ptr, usize size);
+// ptr must be page aligned
 bool vmemCommit(void *ptr, usize num_of_pages);
+// faults in committed pages, so the first touch doesn't page fault. ptr must be page aligned
+void vmemPrefault(void *ptr, usize num_of_pages);
+// gives the pages back to the os, ptr must be page aligned. the range has to be committed
+// again before using it: on windows touching it faults, on linux it reads back as zeros
+bool vmemDecommit(void *ptr, usize num_of_pages);
 usize vmemGetPageSize(void);
 usize vmemPadToPage(usize byte_count);
 
-#endif // VIRTUAL_MEMORY_HEADER
\ No newline at end of file
+#endif // VIRTUAL_MEMORY_HEADER
@@ -4,24 +4,29 @@
 #include "strstream.h"
 #include "tracelog.h"
 
-static xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in);
+static xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in, const xmlopts_t *opts);
+static void xml__free_tag(xmltag_t *tag, const xmlopts_t *opts);
 
 xml_t xmlParse(arena_t *arena, strview_t filename) {
     return xmlParseStr(arena, fileReadWholeStr(arena, filename));
 }
 
 xml_t xmlParseStr(arena_t *arena, str_t xmlstr) {
+    return xmlParseStrOpts(arena, xmlstr, NULL);
+}
+
+xml_t xmlParseStrOpts(arena_t *arena, str_t xmlstr, const xmlopts_t *options) {
+    xmlopts_t opts = options ? *options : (xmlopts_t){0};
+
     xml_t out = {
         .text = xmlstr,
-        .root = alloc(arena, xmltag_t),
+        .root = opts.tag_pool ? poolNew(opts.tag_pool, xmltag_t) : alloc(arena, xmltag_t),
     };
 
-    
-
     instream_t in = istrInitLen(xmlstr.buf, xmlstr.len);
 
     while (!istrIsFinished(in)) {
-        xmltag_t *tag = xml__parse_tag(arena, &in);
+        xmltag_t *tag = xml__parse_tag(arena, &in, &opts);
 
         if (out.tail) out.tail->next = tag;
         else          out.root->child = tag;
@@ -32,6 +37,15 @@ xml_t xmlParseStr(arena_t *arena, str_t xmlstr) {
     return out;
 }
 
+void xmlFree(xml_t *xml, const xmlopts_t *options) {
+    if (!xml || !options) {
+        return;
+    }
+
+    xml__free_tag(xml->root, options);
+    xml->root = xml->tail = NULL;
+}
+
 xmltag_t *xmlGetTag(xmltag_t *parent, strview_t key, bool recursive) {
     xmltag_t *t = parent ? parent->child : NULL;
     while (t) {
@@ -62,7 +76,7 @@ strview_t xmlGetAttribute(xmltag_t *tag, strview_t key) {
 
 // == PRIVATE FUNCTIONS ========================================================================
 
-static xmlattr_t *xml__parse_attr(arena_t *arena, instream_t *in) {
+static xmlattr_t *xml__parse_attr(arena_t *arena, instream_t *in, const xmlopts_t *opts) {
     if (istrPeek(in) != ' ') {
         return NULL;
     }
@@ -77,13 +91,13 @@ static xmlattr_t *xml__parse_attr(arena_t *arena, instream_t *in) {
         return NULL;
     }
     
-    xmlattr_t *attr = alloc(arena, xmlattr_t);
+    xmlattr_t *attr = opts->attr_pool ? poolNew(opts->attr_pool, xmlattr_t) : alloc(arena, xmlattr_t);
     attr->key = key;
     attr->value = val;
     return attr;
 }
 
-static xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in) {
+static xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in, const xmlopts_t *opts) {
     istrSkipWhitespace(in);
 
     // we're either parsing the body, or we have finished the object
@@ -99,15 +113,15 @@ static xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in) {
         return NULL;
     }
 
-    xmltag_t *tag = alloc(arena, xmltag_t);
+    xmltag_t *tag = opts->tag_pool ? poolNew(opts->tag_pool, xmltag_t) : alloc(arena, xmltag_t);
 
     tag->key = strvTrim(istrGetViewEither(in, strv(" >")));
 
-    xmlattr_t *attr = xml__parse_attr(arena, in);
+    xmlattr_t *attr = xml__parse_attr(arena, in, opts);
     while (attr) {
         attr->next = tag->attributes;
         tag->attributes = attr;
-        attr = xml__parse_attr(arena, in);
+        attr = xml__parse_attr(arena, in, opts);
     }
 
     // this tag does not have children, return
@@ -118,7 +132,7 @@ static xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in) {
 
     istrSkip(in, 1); // skip >
 
-    xmltag_t *child = xml__parse_tag(arena, in);
+    xmltag_t *child = xml__parse_tag(arena, in, opts);
     while (child) {
         if (tag->tail) {
             tag->tail->next = child;
@@ -127,7 +141,7 @@ static xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in) {
         else {
             tag->child = tag->tail = child;
         }
-        child = xml__parse_tag(arena, in);
+        child = xml__parse_tag(arena, in, opts);
     }
 
     // parse content
@@ -143,3 +157,21 @@ static xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in) {
     istrSkip(in, 1); // skip >
     return tag;
 }
+
+static void xml__free_tag(xmltag_t *tag, const xmlopts_t *opts) {
+    while (tag) {
+        xmltag_t *next = tag->next;
+
+        xmlattr_t *attr = tag->attributes;
+        while (attr) {
+            xmlattr_t *next_attr = attr->next;
+            poolFree(opts->attr_pool, attr);
+            attr = next_attr;
+        }
+
+        xml__free_tag(tag->child, opts);
+        poolFree(opts->tag_pool, tag);
+
+        tag = next;
+    }
+}
@@ -24,8 +24,16 @@ typedef struct {
     xmltag_t *tail;
 } xml_t;
 
+typedef struct {
+    arena_pool_t *tag_pool;  // default NULL, tags are allocated from the arena
+    arena_pool_t *attr_pool; // default NULL, attributes are allocated from the arena
+} xmlopts_t;
+
 xml_t xmlParse(arena_t *arena, strview_t filename);
 xml_t xmlParseStr(arena_t *arena, str_t xmlstr);
+xml_t xmlParseStrOpts(arena_t *arena, str_t xmlstr, const xmlopts_t *options);
+// gives tags and attributes back to the pools in options, if any
+void xmlFree(xml_t *xml, const xmlopts_t *options);
 
 xmltag_t *xmlGetTag(xmltag_t *parent, strview_t key, bool recursive);
 strview_t xmlGetAttribute(xmltag_t *tag, strview_t key);
\ No newline at end of file
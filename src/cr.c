@@ -4,13 +4,30 @@
 #include "colla/file.h"
 #include "colla/tracelog.h"
 
-// todo linux support?
 #if COLLA_WIN
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+
+typedef HMODULE cr_lib_t;
+// FILETIME resolution
+#define CR_TICKS_PER_MS 10000.0
 #else
-// patch stuff up for cross platform for now, the actual program should not really call anything for now
-#define HMODULE void*
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <linux/fs.h>
+#include <linux/memfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef void *cr_lib_t;
+#define CR_TICKS_PER_MS 1000000.0
 #endif
 
 typedef int (*cr_f)(cr_t *ctx);
@@ -19,86 +36,359 @@ typedef struct {
     arena_t arena;
     str_t path;
     uint64 last_timestamp;
-    HMODULE handle;
+    // time at which the currently loaded library was written, used to log the reload latency
+    uint64 write_time;
+    bool log_latency;
+#if !COLLA_WIN
+    int watch_fd;
+    // set until the first load, after that only inotify events trigger one
+    bool needs_load;
+    // memfd backing the loaded library, closed once the next version is loaded
+    int staged_fd;
+    int next_staged_fd;
+    // highest fd number a memfd was staged on, every version gets a bigger one
+    int max_staged_fd;
+#endif
+    cr_lib_t handle;
     cr_f cr_init;
     cr_f cr_loop;
     cr_f cr_close;
 } crinternal_t;
 
-static bool cr_file_copy(arena_t scratch, strview_t src, strview_t dst) {
-    buffer_t srcbuf = fileReadWhole(&scratch, src);
-    if (srcbuf.data == NULL || srcbuf.len == 0) {
-        err("fileReadWhole(%v) returned an empty buffer", src);
+static str_t cr__versioned_path(crinternal_t *cr, arena_t *arena, int version) {
+    strview_t dir, name, ext;
+    fileSplitPath(strv(cr->path), &dir, &name, &ext);
+    return strFmt(arena, "%v/%v-%d%v", dir, name, version, ext);
+}
+
+// == PLATFORM =========================================================================================================
+
+#if COLLA_WIN
+
+static cr_lib_t cr__lib_load(str_t path) {
+    cr_lib_t lib = LoadLibraryA(path.buf);
+    if (!lib) {
+        err("couldn't load %v: %u", path, GetLastError());
+    }
+    return lib;
+}
+
+static void cr__lib_free(cr_lib_t lib) {
+    FreeLibrary(lib);
+}
+
+static cr_f cr__lib_sym(cr_lib_t lib, const char *name) {
+    cr_f fn = (cr_f)GetProcAddress(lib, name);
+    if (!fn) {
+        err("couldn't load address for %s: %u", name, GetLastError());
+    }
+    return fn;
+}
+
+static uint64 cr__now(void) {
+    FILETIME time = {0};
+    GetSystemTimeAsFileTime(&time);
+    ULARGE_INTEGER utime = {
+        .HighPart = time.dwHighDateTime,
+        .LowPart = time.dwLowDateTime,
+    };
+    return (uint64)utime.QuadPart;
+}
+
+static bool cr__watch_init(crinternal_t *cr) {
+    return true;
+}
+
+static void cr__watch_cleanup(crinternal_t *cr) {
+}
+
+// returns true if the library was written since the last load attempt
+static bool cr__changed(crinternal_t *cr) {
+    uint64 now = fileGetTime(cr->arena, strv(cr->path));
+    if (now <= cr->last_timestamp) {
+        return false;
+    }
+    cr->write_time = now;
+    return true;
+}
+
+// the write was acted upon, if loading it fails only the next one is tried
+static void cr__seen(crinternal_t *cr) {
+    cr->last_timestamp = cr->write_time;
+}
+
+// can't load the library directly as it would be locked until it's freed,
+// CopyFile stays in the kernel and clones the blocks on filesystems that support it
+static str_t cr__stage(crinternal_t *cr, arena_t *arena, int version) {
+    str_t lib = cr__versioned_path(cr, arena, version);
+    if (!CopyFileA(cr->path.buf, lib.buf, FALSE)) {
+        err("couldn't copy %v to %v: %u", cr->path, lib, GetLastError());
+        return (str_t){0};
+    }
+    return lib;
+}
+
+static void cr__unstage(crinternal_t *cr, bool all) {
+}
+
+#else
+
+static cr_lib_t cr__lib_load(str_t path) {
+    cr_lib_t lib = dlopen(path.buf, RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+        err("couldn't load %v: %s", path, dlerror());
+    }
+    return lib;
+}
+
+static void cr__lib_free(cr_lib_t lib) {
+    dlclose(lib);
+}
+
+static cr_f cr__lib_sym(cr_lib_t lib, const char *name) {
+    // clear any previous error, dlsym can legitimately return NULL
+    dlerror();
+    cr_f fn = (cr_f)dlsym(lib, name);
+    if (!fn) {
+        const char *error = dlerror();
+        err("couldn't load address for %s: %s", name, error ? error : "symbol is NULL");
+    }
+    return fn;
+}
+
+// same clock as st_mtim, so the latency includes the time spent before we noticed the change
+static uint64 cr__now(void) {
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64)ts.tv_sec * 1000000000ull + (uint64)ts.tv_nsec;
+}
+
+static uint64 cr__write_time(crinternal_t *cr) {
+    struct stat st = {0};
+    if (stat(cr->path.buf, &st) != 0) {
+        return 0;
+    }
+    return (uint64)st.st_mtim.tv_sec * 1000000000ull + (uint64)st.st_mtim.tv_nsec;
+}
+
+static bool cr__watch_init(crinternal_t *cr) {
+    cr->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cr->watch_fd < 0) {
+        err("inotify_init1 failed: %s", strerror(errno));
         return false;
     }
-    if (!fileWriteWhole(scratch, dst, srcbuf.data, srcbuf.len)) {
-        err("fileWriteWhole failed");
+
+    // watch the directory and not the file itself: linkers usually unlink the old
+    // output and create a new one, which would silently drop a watch on the file
+    arena_t scratch = cr->arena;
+    strview_t dir;
+    fileSplitPath(strv(cr->path), &dir, NULL, NULL);
+    str_t dirname = strvIsEmpty(dir) ? str(&scratch, ".") : str(&scratch, dir);
+
+    if (inotify_add_watch(cr->watch_fd, dirname.buf, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        err("couldn't watch %v: %s", dirname, strerror(errno));
+        close(cr->watch_fd);
+        cr->watch_fd = -1;
         return false;
     }
+
     return true;
 }
 
+static void cr__watch_cleanup(crinternal_t *cr) {
+    if (cr->watch_fd >= 0) {
+        close(cr->watch_fd);
+        cr->watch_fd = -1;
+    }
+}
+
+// drains every pending event without blocking, returns true if one of them was for the library.
+// a library that failed to load isn't retried until it's written again
+static bool cr__changed(crinternal_t *cr) {
+    strview_t filename = fileGetFilename(strv(cr->path));
+    bool changed = cr->needs_load;
+    cr->needs_load = false;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (true) {
+        ssize_t len = read(cr->watch_fd, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char *ptr = buf; ptr < buf + len;) {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            if (event->len && strvEquals(strv(event->name), filename)) {
+                changed = true;
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    if (changed) {
+        cr->write_time = cr__write_time(cr);
+    }
+
+    return changed;
+}
+
+// the write was acted upon, if loading it fails only the next one is tried
+static void cr__seen(crinternal_t *cr) {
+    cr->last_timestamp = cr->write_time;
+}
+
+// copy_file_range refuses some combinations of filesystems, sendfile works with any regular file
+static bool cr__kernel_copy(int in, int out, usize size) {
+    bool use_sendfile = false;
+    usize copied = 0;
+
+    while (copied < size) {
+        ssize_t n = 0;
+        if (!use_sendfile) {
+            n = syscall(SYS_copy_file_range, in, NULL, out, NULL, size - copied, 0);
+            if (n < 0 && copied == 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+                use_sendfile = true;
+                continue;
+            }
+        }
+        else {
+            n = sendfile(out, in, NULL, size - copied);
+        }
+
+        if (n <= 0) {
+            return false;
+        }
+        copied += (usize)n;
+    }
+
+    return true;
+}
+
+// dlopen returns the cached handle when given a path it already loaded, so every version
+// needs its own file: prefer an anonymous memfd, nothing ends up on disk and the kernel
+// frees it once the library is unloaded. if that's not available, stage a versioned file
+// next to the library, sharing its extents when the filesystem supports reflinks
+static str_t cr__stage(crinternal_t *cr, arena_t *arena, int version) {
+    int in = open(cr->path.buf, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        err("couldn't open %v: %s", cr->path, strerror(errno));
+        return (str_t){0};
+    }
+
+    struct stat st = {0};
+    if (fstat(in, &st) != 0) {
+        err("couldn't stat %v: %s", cr->path, strerror(errno));
+        close(in);
+        return (str_t){0};
+    }
+
+    str_t staged = {0};
+    str_t lib = cr__versioned_path(cr, arena, version);
+
+    // called through syscall so it doesn't depend on _GNU_SOURCE being defined before the first include
+    int out = (int)syscall(SYS_memfd_create, fileGetFilename(strv(lib)).buf, MFD_CLOEXEC);
+    // fd numbers are reused once closed, and dlopen hands back the cached handle for a /proc path
+    // it still has loaded (e.g. a library dlclose couldn't unload), so move it past every number used
+    if (out >= 0 && out <= cr->max_staged_fd) {
+        int fd = fcntl(out, F_DUPFD_CLOEXEC, cr->max_staged_fd + 1);
+        close(out);
+        out = fd;
+    }
+    if (out >= 0) {
+        cr->max_staged_fd = out;
+        if (cr__kernel_copy(in, out, (usize)st.st_size)) {
+            staged = strFmt(arena, "/proc/self/fd/%d", out);
+            cr->next_staged_fd = out;
+        }
+        else {
+            close(out);
+        }
+    }
+
+    if (!staged.buf) {
+        out = open(lib.buf, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+        if (out < 0) {
+            err("couldn't create %v: %s", lib, strerror(errno));
+        }
+        else {
+            if (ioctl(out, FICLONE, in) == 0 || cr__kernel_copy(in, out, (usize)st.st_size)) {
+                staged = lib;
+            }
+            else {
+                err("couldn't copy %v to %v: %s", cr->path, lib, strerror(errno));
+            }
+            close(out);
+        }
+    }
+
+    close(in);
+    return staged;
+}
+
+// closes the memfd of the previous version, or every one if all is true
+static void cr__unstage(crinternal_t *cr, bool all) {
+    if (cr->staged_fd >= 0) {
+        close(cr->staged_fd);
+    }
+    cr->staged_fd = cr->next_staged_fd;
+    cr->next_staged_fd = -1;
+
+    if (all && cr->staged_fd >= 0) {
+        close(cr->staged_fd);
+        cr->staged_fd = -1;
+    }
+}
+
+#endif
+
+// == INTERNAL =========================================================================================================
+
 static bool cr_reload(cr_t *ctx) {
 #ifndef CR_DISABLE
     crinternal_t *cr = ctx->p;
     arena_t scratch = cr->arena;
 
-    if (!fileExists(cr->path.buf)) {
-        err("dll file %v does not exist anymore!", cr->path);
+    if (!cr__changed(cr)) {
         return false;
     }
 
-    uint64 now = fileGetTime(scratch, strv(cr->path));
-    if (now <= cr->last_timestamp) {
+    if (!fileExists(cr->path.buf)) {
+        err("library file %v does not exist anymore!", cr->path);
         return false;
     }
 
-    ctx->version = ctx->last_working_version + 1;
+    cr__seen(cr);
 
-    // can't copy the dll directly, make a temporary one based on the version
-    strview_t dir, name, ext;
-    fileSplitPath(strv(cr->path), &dir, &name, &ext);
-    str_t dll = strFmt(&scratch, "%v/%v-%d%v", dir, name, ctx->version, ext);
+    ctx->version = ctx->last_working_version + 1;
 
-    if (!cr_file_copy(scratch, strv(cr->path), strv(dll))) {
-        err("failed to copy %v to %v", cr->path, dll);
+    // scratch is a copy, everything allocated here is gone once the reload is done
+    str_t lib = cr__stage(cr, &scratch, ctx->version);
+    if (!lib.buf) {
         return false;
     }
 
-    info("loading library: %v", dll);
+    info("loading library: %v", lib);
 
-    if (cr->handle) FreeLibrary(cr->handle);
+    if (cr->handle) cr__lib_free(cr->handle);
 
-    cr->handle = LoadLibraryA(dll.buf);
+    cr->handle = cr__lib_load(lib);
+    // the previous version is unloaded, its staged copy can go
+    cr__unstage(cr, false);
     if (!cr->handle) {
-        err("couldn't load %v: %u", dll, GetLastError());
-        return true;
-    }
-
-    cr->cr_init = (cr_f)GetProcAddress(cr->handle, "cr_init");
-    DWORD init_err = GetLastError();
-    cr->cr_loop = (cr_f)GetProcAddress(cr->handle, "cr_loop");
-    DWORD loop_err = GetLastError();
-    cr->cr_close = (cr_f)GetProcAddress(cr->handle, "cr_close");
-    DWORD close_err = GetLastError();
-
-    if (!cr->cr_init) {
-        err("couldn't load address for cr_init: %u", init_err);
         goto error;
     }
 
-    if (!cr->cr_loop) {
-        err("couldn't load address for cr_loop: %u", loop_err);
-        goto error;
-    }
+    cr->cr_init = cr__lib_sym(cr->handle, "cr_init");
+    cr->cr_loop = cr__lib_sym(cr->handle, "cr_loop");
+    cr->cr_close = cr__lib_sym(cr->handle, "cr_close");
 
-    if (!cr->cr_close) {
-        err("couldn't load address for cr_close: %u", close_err);
+    if (!cr->cr_init || !cr->cr_loop || !cr->cr_close) {
         goto error;
     }
 
     info("Reloaded, version: %d", ctx->version);
-    cr->last_timestamp = now;
+    cr->log_latency = ctx->last_working_version > 0;
     ctx->last_working_version = ctx->version;
 
     cr->cr_init(ctx);
@@ -106,7 +396,7 @@ static bool cr_reload(cr_t *ctx) {
     return true;
 
 error:
-    if (cr->handle) FreeLibrary(cr->handle);
+    if (cr->handle) cr__lib_free(cr->handle);
     cr->handle = NULL;
     cr->cr_init = cr->cr_loop = cr->cr_close = NULL;
     return false;
@@ -115,6 +405,8 @@ error:
     return true;
 }
 
+// == PUBLIC FUNCTIONS =================================================================================================
+
 bool crOpen(cr_t *ctx, strview_t path) {
 #ifdef CR_DISABLE
     cr_init(ctx);
@@ -125,7 +417,7 @@ bool crOpen(cr_t *ctx, strview_t path) {
     str_t path_copy = str(&arena, path);
 
     if (!fileExists(path_copy.buf)) {
-        err("dll file: %v does not exist", path);
+        err("library file: %v does not exist", path);
         arenaCleanup(&arena);
         return false;
     }
@@ -133,6 +425,15 @@ bool crOpen(cr_t *ctx, strview_t path) {
     crinternal_t *cr = alloc(&arena, crinternal_t);
     cr->arena = arena;
     cr->path = path_copy;
+#if !COLLA_WIN
+    cr->staged_fd = cr->next_staged_fd = cr->max_staged_fd = -1;
+    cr->needs_load = true;
+#endif
+
+    if (!cr__watch_init(cr)) {
+        arenaCleanup(&arena);
+        return false;
+    }
 
     ctx->p = cr;
     ctx->last_working_version = 0;
@@ -151,25 +452,25 @@ void crClose(cr_t *ctx, bool clean_temp_files) {
     }
 
     if (clean_temp_files) {
-        crinternal_t *cr = ctx->p;
         arena_t scratch = cr->arena;
 
-        strview_t dir, name, ext;
-        fileSplitPath(strv(cr->path), &dir, &name, &ext);
-
         for (int i = 0; i < ctx->last_working_version; ++i) {
-            str_t fname = strFmt(&scratch, "%v/%v-%d%v", dir, name, i + 1, ext);
-            bool r = fileDelete(scratch, strv(fname));
+            str_t fname = cr__versioned_path(cr, &scratch, i + 1);
+            fileDelete(scratch, strv(fname));
         }
     }
 
     if (cr->handle) {
-        FreeLibrary(cr->handle);
+        cr__lib_free(cr->handle);
     }
 
+    cr__unstage(cr, true);
+
     cr->handle = NULL;
     cr->cr_init = cr->cr_loop = cr->cr_close = NULL;
 
+    cr__watch_cleanup(cr);
+
     arena_t arena = cr->arena;
     arenaCleanup(&arena);
 
@@ -188,6 +489,12 @@ int crStep(cr_t *ctx) {
     if (cr->cr_loop) {
         result = cr->cr_loop(ctx);
     }
+
+    if (cr->log_latency) {
+        cr->log_latency = false;
+        info("reload latency: %.2fms from library write to first cr_loop", (double)(cr__now() - cr->write_time) / CR_TICKS_PER_MS);
+    }
+
     return result;
 #endif
 }
@@ -4,9 +4,11 @@
 
 #if COLLA_WIN
 #define CR_EXPORT __declspec(dllexport)
+#define CR_LIB_EXT ".dll"
 #else
-// todo linux support?
-#define CR_EXPORT
+// build the client with -fvisibility=hidden to only export the api functions
+#define CR_EXPORT __attribute__((visibility("default")))
+#define CR_LIB_EXT ".so"
 #endif
 
 
@@ -0,0 +1,296 @@
+#include "gpucache.h"
+
+#include <string.h>
+
+#include "colla/tracelog.h"
+
+typedef struct {
+    uint64 hash;
+    sg_shader shader;
+    bool used;
+} gpucache__shader_t;
+
+typedef struct {
+    uint64 hash;
+    sg_pipeline pipeline;
+    bool used;
+} gpucache__pipeline_t;
+
+static struct {
+    gpucache__shader_t shaders[GPUCACHE_MAX_SHADERS];
+    int shader_count;
+    gpucache__pipeline_t pipelines[GPUCACHE_MAX_PIPELINES];
+    int pipeline_count;
+
+    // since the last sweep
+    int created;
+    int reused;
+} gpucache = {0};
+
+// == HASHING ==========================================================================================================
+
+#define GPUCACHE_FNV_PRIME  0x100000001b3ull
+#define GPUCACHE_FNV_OFFSET 0xcbf29ce484222325ull
+
+static uint64 gpucache__hash(uint64 hash, const void *buf, usize len) {
+    const uint8 *data = buf;
+    for (usize i = 0; i < len; ++i) {
+        hash = (hash ^ data[i]) * GPUCACHE_FNV_PRIME;
+    }
+    return hash;
+}
+
+// strings live in the client library, so they move on every reload: hash what they point to
+static uint64 gpucache__hash_str(uint64 hash, const char *str) {
+    if (!str) {
+        return gpucache__hash(hash, "", 1);
+    }
+    // include the terminator so "ab" + "c" and "a" + "bc" don't collide
+    return gpucache__hash(hash, str, strlen(str) + 1);
+}
+
+static uint64 gpucache__hash_int(uint64 hash, int64 value) {
+    return gpucache__hash(hash, &value, sizeof(value));
+}
+
+static uint64 gpucache__hash_stage(uint64 hash, const sg_shader_stage_desc *stage) {
+    hash = gpucache__hash_str(hash, stage->source);
+    hash = gpucache__hash_int(hash, (int64)stage->bytecode.size);
+    if (stage->bytecode.ptr) {
+        hash = gpucache__hash(hash, stage->bytecode.ptr, stage->bytecode.size);
+    }
+    hash = gpucache__hash_str(hash, stage->entry);
+    hash = gpucache__hash_str(hash, stage->d3d11_target);
+
+    for (int i = 0; i < SG_MAX_SHADERSTAGE_UBS; ++i) {
+        const sg_shader_uniform_block_desc *ub = &stage->uniform_blocks[i];
+        hash = gpucache__hash_int(hash, (int64)ub->size);
+        hash = gpucache__hash_int(hash, ub->layout);
+        for (int u = 0; u < SG_MAX_UB_MEMBERS; ++u) {
+            hash = gpucache__hash_str(hash, ub->uniforms[u].name);
+            hash = gpucache__hash_int(hash, ub->uniforms[u].type);
+            hash = gpucache__hash_int(hash, ub->uniforms[u].array_count);
+        }
+    }
+
+    // these don't have any pointers, but go field by field so padding can't change the hash
+    for (int i = 0; i < SG_MAX_SHADERSTAGE_STORAGEBUFFERS; ++i) {
+        hash = gpucache__hash_int(hash, stage->storage_buffers[i].used);
+        hash = gpucache__hash_int(hash, stage->storage_buffers[i].readonly);
+    }
+
+    for (int i = 0; i < SG_MAX_SHADERSTAGE_IMAGES; ++i) {
+        hash = gpucache__hash_int(hash, stage->images[i].used);
+        hash = gpucache__hash_int(hash, stage->images[i].multisampled);
+        hash = gpucache__hash_int(hash, stage->images[i].image_type);
+        hash = gpucache__hash_int(hash, stage->images[i].sample_type);
+    }
+
+    for (int i = 0; i < SG_MAX_SHADERSTAGE_SAMPLERS; ++i) {
+        hash = gpucache__hash_int(hash, stage->samplers[i].used);
+        hash = gpucache__hash_int(hash, stage->samplers[i].sampler_type);
+    }
+
+    for (int i = 0; i < SG_MAX_SHADERSTAGE_IMAGESAMPLERPAIRS; ++i) {
+        const sg_shader_image_sampler_pair_desc *pair = &stage->image_sampler_pairs[i];
+        hash = gpucache__hash_int(hash, pair->used);
+        hash = gpucache__hash_int(hash, pair->image_slot);
+        hash = gpucache__hash_int(hash, pair->sampler_slot);
+        hash = gpucache__hash_str(hash, pair->glsl_name);
+    }
+
+    return hash;
+}
+
+static uint64 gpucache__hash_shader(const sg_shader_desc *desc) {
+    uint64 hash = GPUCACHE_FNV_OFFSET;
+
+    for (int i = 0; i < SG_MAX_VERTEX_ATTRIBUTES; ++i) {
+        hash = gpucache__hash_str(hash, desc->attrs[i].name);
+        hash = gpucache__hash_str(hash, desc->attrs[i].sem_name);
+        hash = gpucache__hash_int(hash, desc->attrs[i].sem_index);
+    }
+
+    hash = gpucache__hash_stage(hash, &desc->vs);
+    hash = gpucache__hash_stage(hash, &desc->fs);
+    hash = gpucache__hash_str(hash, desc->label);
+
+    return hash;
+}
+
+static uint64 gpucache__hash_float(uint64 hash, float value) {
+    return gpucache__hash(hash, &value, sizeof(value));
+}
+
+static uint64 gpucache__hash_stencil_face(uint64 hash, const sg_stencil_face_state *face) {
+    hash = gpucache__hash_int(hash, face->compare);
+    hash = gpucache__hash_int(hash, face->fail_op);
+    hash = gpucache__hash_int(hash, face->depth_fail_op);
+    hash = gpucache__hash_int(hash, face->pass_op);
+    return hash;
+}
+
+static uint64 gpucache__hash_pipeline(const sg_pipeline_desc *desc) {
+    // field by field like shaders, the padding of a description built in the client
+    // isn't guaranteed to be zeroed. the shader is an id, so a pipeline is recreated
+    // whenever its shader changed
+    uint64 hash = GPUCACHE_FNV_OFFSET;
+    hash = gpucache__hash_int(hash, desc->shader.id);
+
+    for (int i = 0; i < SG_MAX_VERTEX_BUFFERS; ++i) {
+        const sg_vertex_buffer_layout_state *buffer = &desc->layout.buffers[i];
+        hash = gpucache__hash_int(hash, buffer->stride);
+        hash = gpucache__hash_int(hash, buffer->step_func);
+        hash = gpucache__hash_int(hash, buffer->step_rate);
+    }
+
+    for (int i = 0; i < SG_MAX_VERTEX_ATTRIBUTES; ++i) {
+        const sg_vertex_attr_state *attr = &desc->layout.attrs[i];
+        hash = gpucache__hash_int(hash, attr->buffer_index);
+        hash = gpucache__hash_int(hash, attr->offset);
+        hash = gpucache__hash_int(hash, attr->format);
+    }
+
+    hash = gpucache__hash_int(hash, desc->depth.pixel_format);
+    hash = gpucache__hash_int(hash, desc->depth.compare);
+    hash = gpucache__hash_int(hash, desc->depth.write_enabled);
+    hash = gpucache__hash_float(hash, desc->depth.bias);
+    hash = gpucache__hash_float(hash, desc->depth.bias_slope_scale);
+    hash = gpucache__hash_float(hash, desc->depth.bias_clamp);
+
+    hash = gpucache__hash_int(hash, desc->stencil.enabled);
+    hash = gpucache__hash_stencil_face(hash, &desc->stencil.front);
+    hash = gpucache__hash_stencil_face(hash, &desc->stencil.back);
+    hash = gpucache__hash_int(hash, desc->stencil.read_mask);
+    hash = gpucache__hash_int(hash, desc->stencil.write_mask);
+    hash = gpucache__hash_int(hash, desc->stencil.ref);
+
+    hash = gpucache__hash_int(hash, desc->color_count);
+    for (int i = 0; i < SG_MAX_COLOR_ATTACHMENTS; ++i) {
+        const sg_color_target_state *color = &desc->colors[i];
+        hash = gpucache__hash_int(hash, color->pixel_format);
+        hash = gpucache__hash_int(hash, color->write_mask);
+        hash = gpucache__hash_int(hash, color->blend.enabled);
+        hash = gpucache__hash_int(hash, color->blend.src_factor_rgb);
+        hash = gpucache__hash_int(hash, color->blend.dst_factor_rgb);
+        hash = gpucache__hash_int(hash, color->blend.op_rgb);
+        hash = gpucache__hash_int(hash, color->blend.src_factor_alpha);
+        hash = gpucache__hash_int(hash, color->blend.dst_factor_alpha);
+        hash = gpucache__hash_int(hash, color->blend.op_alpha);
+    }
+
+    hash = gpucache__hash_int(hash, desc->primitive_type);
+    hash = gpucache__hash_int(hash, desc->index_type);
+    hash = gpucache__hash_int(hash, desc->cull_mode);
+    hash = gpucache__hash_int(hash, desc->face_winding);
+    hash = gpucache__hash_int(hash, desc->sample_count);
+    hash = gpucache__hash_float(hash, desc->blend_color.r);
+    hash = gpucache__hash_float(hash, desc->blend_color.g);
+    hash = gpucache__hash_float(hash, desc->blend_color.b);
+    hash = gpucache__hash_float(hash, desc->blend_color.a);
+    hash = gpucache__hash_int(hash, desc->alpha_to_coverage_enabled);
+    hash = gpucache__hash_str(hash, desc->label);
+
+    return hash;
+}
+
+// == PUBLIC FUNCTIONS =================================================================================================
+
+sg_shader gpucacheMakeShader(const sg_shader_desc *desc) {
+    uint64 hash = gpucache__hash_shader(desc);
+
+    for (int i = 0; i < gpucache.shader_count; ++i) {
+        gpucache__shader_t *entry = &gpucache.shaders[i];
+        if (entry->hash == hash) {
+            entry->used = true;
+            gpucache.reused++;
+            return entry->shader;
+        }
+    }
+
+    if (gpucache.shader_count >= GPUCACHE_MAX_SHADERS) {
+        fatal("too many shaders in the gpu cache, max is %d", GPUCACHE_MAX_SHADERS);
+    }
+
+    sg_shader shader = sg_make_shader(desc);
+    gpucache.shaders[gpucache.shader_count++] = (gpucache__shader_t){
+        .hash = hash,
+        .shader = shader,
+        .used = true,
+    };
+    gpucache.created++;
+
+    return shader;
+}
+
+sg_pipeline gpucacheMakePipeline(const sg_pipeline_desc *desc) {
+    uint64 hash = gpucache__hash_pipeline(desc);
+
+    for (int i = 0; i < gpucache.pipeline_count; ++i) {
+        gpucache__pipeline_t *entry = &gpucache.pipelines[i];
+        if (entry->hash == hash) {
+            entry->used = true;
+            gpucache.reused++;
+            return entry->pipeline;
+        }
+    }
+
+    if (gpucache.pipeline_count >= GPUCACHE_MAX_PIPELINES) {
+        fatal("too many pipelines in the gpu cache, max is %d", GPUCACHE_MAX_PIPELINES);
+    }
+
+    sg_pipeline pipeline = sg_make_pipeline(desc);
+    gpucache.pipelines[gpucache.pipeline_count++] = (gpucache__pipeline_t){
+        .hash = hash,
+        .pipeline = pipeline,
+        .used = true,
+    };
+    gpucache.created++;
+
+    return pipeline;
+}
+
+void gpucacheSweep(void) {
+    if (gpucache.created == 0 && gpucache.reused == 0) {
+        return;
+    }
+
+    int destroyed = 0;
+
+    // pipelines first, they reference the shaders
+    for (int i = gpucache.pipeline_count - 1; i >= 0; --i) {
+        gpucache__pipeline_t *entry = &gpucache.pipelines[i];
+        if (entry->used) {
+            entry->used = false;
+            continue;
+        }
+        sg_destroy_pipeline(entry->pipeline);
+        *entry = gpucache.pipelines[--gpucache.pipeline_count];
+        destroyed++;
+    }
+
+    for (int i = gpucache.shader_count - 1; i >= 0; --i) {
+        gpucache__shader_t *entry = &gpucache.shaders[i];
+        if (entry->used) {
+            entry->used = false;
+            continue;
+        }
+        sg_destroy_shader(entry->shader);
+        *entry = gpucache.shaders[--gpucache.shader_count];
+        destroyed++;
+    }
+
+    info("gpu cache: %d created, %d reused, %d destroyed", gpucache.created, gpucache.reused, destroyed);
+
+    gpucache.created = gpucache.reused = 0;
+}
+
+void gpucacheCleanup(void) {
+    for (int i = 0; i < gpucache.pipeline_count; ++i) {
+        sg_destroy_pipeline(gpucache.pipelines[i].pipeline);
+    }
+    for (int i = 0; i < gpucache.shader_count; ++i) {
+        sg_destroy_shader(gpucache.shaders[i].shader);
+    }
+    gpucache.pipeline_count = gpucache.shader_count = 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "colla/collatypes.h"
+#include "sokol/sokol_gfx.h"
+
+// host owned cache of shaders and pipelines, keyed by the content of their descriptions,
+// so client reloads that don't touch the shaders reuse the existing gpu objects.
+// the client never destroys what it gets from here, after every reload the host calls
+// gpucacheSweep which destroys everything the new client didn't ask for again
+
+#define GPUCACHE_MAX_SHADERS   32
+#define GPUCACHE_MAX_PIPELINES 32
+
+sg_shader gpucacheMakeShader(const sg_shader_desc *desc);
+sg_pipeline gpucacheMakePipeline(const sg_pipeline_desc *desc);
+
+// destroys every object that wasn't requested since the last sweep, does nothing if
+// nothing was requested at all (e.g. the reload failed before cr_init was called)
+void gpucacheSweep(void);
+void gpucacheCleanup(void);
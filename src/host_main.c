@@ -8,12 +8,16 @@
 #include "colla/file.h"
 #include "colla/ini.h"
 #include "colla/strstream.h"
+#include "colla/cthreads.h"
+
+#include <stdatomic.h>
 
 #include "stb_image.h"
 
 // #include "shader.h"
 
 #include "cr.h"
+#include "gpucache.h"
 #include "shared.h"
 #include "display-shd.h"
 
@@ -23,6 +27,56 @@
 #define ASSET_DIR "/assets/projects/clouds/data/"
 #endif
 
+// images are decoded on worker threads and uploaded by the main thread,
+// at most LOADER_UPLOADS_PER_FRAME sg_make_image calls per frame
+#if COLLA_EMC
+// no pthreads on the web build, decode inline in the fetch callback
+#define LOADER_THREADS 0
+#else
+#define LOADER_THREADS 2
+#endif
+#define LOADER_MAX_JOBS 16
+#define LOADER_UPLOADS_PER_FRAME 1
+
+// shaders and the client are rebuilt by a watcher thread so frames keep flowing
+// during the compile, a change is only acted upon once the file stopped changing
+// for REBUILD_DEBOUNCE_MS, so editors saving in multiple steps trigger a single rebuild
+#if COLLA_WIN
+#define HOT_REBUILD 1
+#else
+// linux picks up new client builds through inotify in crReload
+#define HOT_REBUILD 0
+#endif
+#define REBUILD_POLL_MS 100
+#define REBUILD_DEBOUNCE_MS 250
+
+typedef struct {
+    str_t path;
+    const uint8 *data;
+    usize size;
+    sg_image *image;
+} loader_job_t;
+
+// waits in a queue until there is a free job slot
+typedef struct loader_request_t {
+    const char *path;
+    usize max_size;
+    sg_image *image;
+    struct loader_request_t *next;
+} loader_request_t;
+
+typedef struct {
+    atomic_bool ready;
+    str_t path;
+    sg_image *image;
+    int width;
+    int height;
+    // NULL if the image couldn't be decoded
+    const uint8 *pixels;
+    // pixels allocated by stb_image, freed after the upload
+    uint8 *owned;
+} loader_done_t;
+
 static struct {
     sg_pass offscreen_pass;
     int still_loading;
@@ -36,7 +90,41 @@ static struct {
 
     sg_pass_action pass_action;
     arena_t arena;
-    uint64 last_write;
+
+    struct {
+        cthread_t watcher;
+        cmutex_t mtx;
+        condvar_t cond;
+        bool should_stop;
+        // set by the watcher once a new client library is on disk, consumed by checkReload
+        atomic_bool module_ready;
+        atomic_bool rebuilding;
+        int frames_while_rebuilding;
+    } rebuild;
+
+    struct {
+        cthread_t workers[LOADER_THREADS + 1];
+        cmutex_t mtx;
+        condvar_t cond;
+        bool should_stop;
+        loader_job_t jobs[LOADER_MAX_JOBS];
+        int job_head;
+        int job_tail;
+        // multi-producer single-consumer completion ring, workers reserve a
+        // slot with done_write and publish it with loader_done_t.ready
+        loader_done_t done[LOADER_MAX_JOBS];
+        atomic_int done_write;
+        int done_read;
+        // requests are only sent while fewer than LOADER_MAX_JOBS are in flight,
+        // the rest wait here so the rings above can never overflow
+        loader_request_t *pending_head;
+        loader_request_t *pending_tail;
+        int in_flight;
+    } loader;
+
+    uint64 last_frame;
+    uint64 load_start;
+    uint64 longest_load_frame;
 
     host_t host;
     cr_t cr;
@@ -46,6 +134,151 @@ static void slog(const char* tag, uint32 log_level, uint32 log_item_id, const ch
 
 static void checkReload(void);
 
+static void loader_decode(loader_job_t *job) {
+    int width = 0, height = 0;
+    const uint8 *pixels = NULL;
+    uint8 *owned = NULL;
+
+    if (strvEndsWithView(strv(job->path), strv(".raw"))) {
+        // uint16 width, uint16 height, then RGBA8 pixels
+        if (job->size >= sizeof(uint16) * 2) {
+            const uint8 *data = job->data;
+            width = *((uint16*)data);
+            data += sizeof(uint16);
+            height = *((uint16*)data);
+            data += sizeof(uint16);
+            pixels = data;
+
+            if (job->size - sizeof(uint16) * 2 < (usize)width * height * 4) {
+                err("%v is truncated, expected %dx%d pixels", job->path, width, height);
+                pixels = NULL;
+            }
+        }
+    }
+    else {
+        owned = stbi_load_from_memory(job->data, (int)job->size, &width, &height, NULL, 4);
+        pixels = owned;
+        if (!owned) {
+            err("couldn't decode %v: %s", job->path, stbi_failure_reason());
+        }
+    }
+
+    // failures are reported by the main thread, fatal isn't safe to call from a worker
+    int slot = atomic_fetch_add(&state.loader.done_write, 1) % LOADER_MAX_JOBS;
+    loader_done_t *done = &state.loader.done[slot];
+    done->path = job->path;
+    done->image = job->image;
+    done->width = width;
+    done->height = height;
+    done->pixels = pixels;
+    done->owned = owned;
+    atomic_store_explicit(&done->ready, true, memory_order_release);
+}
+
+#if LOADER_THREADS
+static int loader_worker(void *userdata) {
+    (void)userdata;
+
+    while (true) {
+        mtxLock(state.loader.mtx);
+        while (!state.loader.should_stop && state.loader.job_head == state.loader.job_tail) {
+            condWait(state.loader.cond, state.loader.mtx);
+        }
+        if (state.loader.should_stop) {
+            mtxUnlock(state.loader.mtx);
+            break;
+        }
+        loader_job_t job = state.loader.jobs[state.loader.job_tail++ % LOADER_MAX_JOBS];
+        mtxUnlock(state.loader.mtx);
+
+        loader_decode(&job);
+    }
+
+    return 0;
+}
+#endif
+
+static void loader_init(void) {
+#if LOADER_THREADS
+    state.loader.mtx = mtxInit();
+    state.loader.cond = condInit();
+    for (int i = 0; i < LOADER_THREADS; ++i) {
+        state.loader.workers[i] = thrCreate(loader_worker, NULL);
+    }
+#endif
+}
+
+static void loader_cleanup(void) {
+#if LOADER_THREADS
+    mtxLock(state.loader.mtx);
+    state.loader.should_stop = true;
+    condWakeAll(state.loader.cond);
+    mtxUnlock(state.loader.mtx);
+
+    for (int i = 0; i < LOADER_THREADS; ++i) {
+        thrJoin(state.loader.workers[i], NULL);
+    }
+
+    condFree(state.loader.cond);
+    mtxFree(state.loader.mtx);
+#endif
+
+    // free anything that was decoded but never uploaded
+    while (state.loader.done_read < atomic_load(&state.loader.done_write)) {
+        loader_done_t *done = &state.loader.done[state.loader.done_read++ % LOADER_MAX_JOBS];
+        stbi_image_free(done->owned);
+    }
+}
+
+static void loader_push(loader_job_t job) {
+#if LOADER_THREADS
+    mtxLock(state.loader.mtx);
+    state.loader.jobs[state.loader.job_head++ % LOADER_MAX_JOBS] = job;
+    condWake(state.loader.cond);
+    mtxUnlock(state.loader.mtx);
+#else
+    loader_decode(&job);
+#endif
+}
+
+static void loader_send(const char *path, usize max_size, sg_image *image);
+
+static void loader_upload(void) {
+    for (int i = 0; i < LOADER_UPLOADS_PER_FRAME; ++i) {
+        loader_done_t *done = &state.loader.done[state.loader.done_read % LOADER_MAX_JOBS];
+        if (!atomic_load_explicit(&done->ready, memory_order_acquire)) {
+            break;
+        }
+
+        if (!done->pixels) {
+            fatal("could not load %v", done->path);
+        }
+
+        *done->image = sg_make_image(&(sg_image_desc){
+            .width = done->width,
+            .height = done->height,
+            .data.subimage[0][0] = { done->pixels, (usize)done->width * done->height * 4 },
+        });
+
+        stbi_image_free(done->owned);
+        atomic_store_explicit(&done->ready, false, memory_order_relaxed);
+        state.loader.done_read++;
+
+        state.still_loading--;
+        state.loader.in_flight--;
+    }
+
+    // a slot was freed, send the requests that were waiting for one
+    while (state.loader.pending_head && state.loader.in_flight < LOADER_MAX_JOBS) {
+        loader_request_t *req = state.loader.pending_head;
+        state.loader.pending_head = req->next;
+        if (!state.loader.pending_head) {
+            state.loader.pending_tail = NULL;
+        }
+        loader_send(req->path, req->max_size, req->image);
+    }
+}
+
 static void image_load_callback(const sfetch_response_t *res) {
     if (res->finished) {
         if (res->failed) {
@@ -61,27 +294,19 @@ static void image_load_callback(const sfetch_response_t *res) {
             fatal("could not load %s: %s", res->path, errors[res->error_code]);
         }
 
-        const uint8 *data = res->data.ptr;
-        
-        uint16 width = *((uint16*)data);
-        data += sizeof(uint16);
-        uint16 height = *((uint16*)data);
-        data += sizeof(uint16);
-        const uint8 *pixels = data;
-
         sg_image **userdata = res->user_data;
-        sg_image *image = *userdata;
-        *image = sg_make_image(&(sg_image_desc){
-            .width = width,
-            .height = height,
-            .data.subimage[0][0] = { pixels, width * height * 4 },
-        });
 
-        state.still_loading--;
+        // the fetch buffer lives in state.arena, so it stays valid until the worker is done with it
+        loader_push((loader_job_t){
+            .path = str(&state.arena, res->path),
+            .data = res->data.ptr,
+            .size = res->data.size,
+            .image = *userdata,
+        });
     }
 }
 
-static void load_image_async(const char *path, usize max_size, sg_image *image) {
+static void loader_send(const char *path, usize max_size, sg_image *image) {
     uint8 *texture_buf = alloc(&state.arena, uint8, max_size);
 
     sfetch_send(&(sfetch_request_t){
@@ -93,7 +318,140 @@ static void load_image_async(const char *path, usize max_size, sg_image *image)
         },
         .user_data = SFETCH_RANGE(image),
     });
+    state.loader.in_flight++;
+}
+
+static void load_image_async(const char *path, usize max_size, sg_image *image) {
     state.still_loading++;
+
+    // both loader rings are sized for LOADER_MAX_JOBS images in flight, queue the rest
+    if (state.loader.in_flight >= LOADER_MAX_JOBS) {
+        loader_request_t *req = alloc(&state.arena, loader_request_t);
+        req->path = str(&state.arena, path).buf;
+        req->max_size = max_size;
+        req->image = image;
+        if (state.loader.pending_tail) {
+            state.loader.pending_tail->next = req;
+        }
+        else {
+            state.loader.pending_head = req;
+        }
+        state.loader.pending_tail = req;
+        return;
+    }
+
+    loader_send(path, max_size, image);
+}
+
+#if HOT_REBUILD
+typedef struct {
+    strview_t path;
+    uint64 last_write;
+    // stm time of the last change that wasn't acted upon yet, 0 if there is none
+    uint64 changed_at;
+} rebuild_watch_t;
+
+static uint64 rebuild_file_time(strview_t path) {
+    uint8 tmpbuf[1024];
+    arena_t scratch = arenaMake(ARENA_STATIC, sizeof(tmpbuf), tmpbuf);
+    return fileGetTime(scratch, path);
+}
+
+// returns true once the file changed and then stayed the same for REBUILD_DEBOUNCE_MS
+static bool rebuild_poll(rebuild_watch_t *watch) {
+    uint64 now = rebuild_file_time(watch->path);
+    if (now != watch->last_write) {
+        watch->last_write = now;
+        watch->changed_at = stm_now();
+        return false;
+    }
+
+    if (watch->changed_at && stm_ms(stm_since(watch->changed_at)) >= REBUILD_DEBOUNCE_MS) {
+        watch->changed_at = 0;
+        return true;
+    }
+
+    return false;
+}
+
+static int rebuild_watcher(void *userdata) {
+    rebuild_watch_t shaders[] = {
+        { .path = strv("assets/shader.glsl") },
+        { .path = strv("assets/display.glsl") },
+    };
+    rebuild_watch_t client = { .path = strv("bin/client" CR_LIB_EXT) };
+
+    for (usize i = 0; i < arrlen(shaders); ++i) {
+        shaders[i].last_write = rebuild_file_time(shaders[i].path);
+    }
+    client.last_write = rebuild_file_time(client.path);
+
+    mtxLock(state.rebuild.mtx);
+    while (!state.rebuild.should_stop) {
+        condWaitTimed(state.rebuild.cond, state.rebuild.mtx, REBUILD_POLL_MS);
+        if (state.rebuild.should_stop) {
+            break;
+        }
+        mtxUnlock(state.rebuild.mtx);
+
+        bool shader_changed = false;
+        for (usize i = 0; i < arrlen(shaders); ++i) {
+            shader_changed |= rebuild_poll(&shaders[i]);
+        }
+
+        if (shader_changed) {
+            info("shader changed, rebuilding");
+
+            atomic_store(&state.rebuild.rebuilding, true);
+            uint64 start = stm_now();
+            int code = system("rebuild");
+            atomic_store(&state.rebuild.rebuilding, false);
+
+            if (code == 0) {
+                info("rebuild finished in %.2fms", stm_ms(stm_since(start)));
+                // no need to debounce our own build, it's already done writing
+                client.last_write = rebuild_file_time(client.path);
+                client.changed_at = 0;
+                atomic_store(&state.rebuild.module_ready, true);
+            }
+            else {
+                err("rebuild failed in %.2fms with exit code %d", stm_ms(stm_since(start)), code);
+            }
+        }
+
+        if (rebuild_poll(&client)) {
+            atomic_store(&state.rebuild.module_ready, true);
+        }
+
+        mtxLock(state.rebuild.mtx);
+    }
+    mtxUnlock(state.rebuild.mtx);
+
+    return 0;
+}
+#endif
+
+static void rebuild_init(void) {
+#if HOT_REBUILD
+    state.rebuild.mtx = mtxInit();
+    state.rebuild.cond = condInit();
+    state.rebuild.watcher = thrCreate(rebuild_watcher, NULL);
+#endif
+}
+
+static void rebuild_cleanup(void) {
+#if HOT_REBUILD
+    mtxLock(state.rebuild.mtx);
+    state.rebuild.should_stop = true;
+    condWake(state.rebuild.cond);
+    mtxUnlock(state.rebuild.mtx);
+
+    // waits for a rebuild that is still running
+    thrJoin(state.rebuild.watcher, NULL);
+
+    condFree(state.rebuild.cond);
+    mtxFree(state.rebuild.mtx);
+#endif
 }
 
 void init(void) {
@@ -111,11 +469,15 @@ void init(void) {
 
     stbi_set_flip_vertically_on_load(true);
 
+    loader_init();
+    state.load_start = stm_now();
+
     state.cr.userdata = &state.host;
     state.just_loaded = true;
     state.host.backend = sg_query_backend();
-    state.host.make_shader = sg_make_shader;
-    state.host.make_pipeline = sg_make_pipeline;
+    // the client's shaders and pipelines are cached by the host, so they survive reloads
+    state.host.make_shader = gpucacheMakeShader;
+    state.host.make_pipeline = gpucacheMakePipeline;
     state.host.destroy_shader = sg_destroy_shader;
     state.host.destroy_pipeline = sg_destroy_pipeline;
     state.host.apply_uniform = sg_apply_uniforms;
@@ -211,23 +573,30 @@ void init(void) {
         .label = "offscreen-pass",
     };
 
-#if COLLA_WIN
-    state.last_write = fileGetTime(state.arena, strv("assets/shader.glsl"));
-#endif
-
-    if (!crOpen(&state.cr, strv("bin/client.dll"))) {
+    if (!crOpen(&state.cr, strv("bin/client" CR_LIB_EXT))) {
         fatal("crOpen failed!");
     }
+    gpucacheSweep();
+
+    rebuild_init();
 }
 
 void frame(void) {
+    uint64 frame_time = stm_laptime(&state.last_frame);
+
     checkReload();
 
     sfetch_dowork();
+    loader_upload();
 
     if (state.still_loading <= 0) {
         if (state.just_loaded) {
             state.just_loaded = false;
+            info(
+                "assets loaded in %.2fms, longest frame while loading: %.2fms", 
+                stm_ms(stm_since(state.load_start)), 
+                stm_ms(state.longest_load_frame)
+            );
             state.host.on_load(&state.host);
         }
 
@@ -271,6 +640,10 @@ void frame(void) {
         }
     }
     else {
+        if (frame_time > state.longest_load_frame) {
+            state.longest_load_frame = frame_time;
+        }
+
         sg_begin_pass(&(sg_pass){ .action = state.display.pass_action, .swapchain = sglue_swapchain() });
         sg_end_pass();
     }
@@ -296,9 +669,12 @@ void save_config() {
 }
 
 void cleanup(void) {
+    rebuild_cleanup();
     crClose(&state.cr, true);
-    sg_shutdown();
     sfetch_shutdown();
+    loader_cleanup();
+    gpucacheCleanup();
+    sg_shutdown();
 
     save_config();
 
@@ -366,13 +742,26 @@ static void slog(const char* tag, uint32 log_level, uint32 log_item_id, const ch
 }
 
 static void checkReload(void) {
-#if COLLA_WIN
-    uint64 now = fileGetTime(state.arena, strv("assets/shader.glsl"));
-    if (now > state.last_write) {
-        state.last_write = now;
-        system("rebuild");
+#if HOT_REBUILD
+    if (atomic_load(&state.rebuild.rebuilding)) {
+        state.rebuild.frames_while_rebuilding++;
+    }
+
+    if (!atomic_exchange(&state.rebuild.module_ready, false)) {
+        return;
+    }
+
+    if (state.rebuild.frames_while_rebuilding) {
+        info("rendered %d frames while rebuilding", state.rebuild.frames_while_rebuilding);
+        state.rebuild.frames_while_rebuilding = 0;
+    }
+
+    if (crReload(&state.cr)) {
+        gpucacheSweep();
+    }
+#elif !COLLA_EMC
+    if (crReload(&state.cr)) {
+        gpucacheSweep();
     }
- 
-    crReload(&state.cr);   
 #endif
 }
\ No newline at end of file
@@ -3,37 +3,444 @@
 
 #include "../src/colla/build.c"
 
-void convert_image(arena_t scratch, const char *from, const char *to) {
+#include <stdatomic.h>
+
+#if COLLA_WIN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#define SOKOL_TIME_IMPL
+#include "../src/sokol/sokol_time.h"
+
+#define CACHE_FILE "bin/convert_cache.ini"
+// bump this whenever the output format changes, so every cached entry is invalidated
+#define CONVERT_SETTINGS "rgba8-u16size-v1"
+#define MAX_THREADS 64
+
+typedef struct convert_job_t {
+    str_t from;
+    str_t to;
+    uint64 cached_hash;
+    // this job's entry in the cache file, if it had one
+    inivalue_t *cached;
+    uint64 hash;
+    usize in_size;
+    bool converted;
+    bool failed;
+    struct convert_job_t *next;
+} convert_job_t;
+
+typedef enum {
+    MIPS_NONE,
+    MIPS_BOX,
+    MIPS_CUBIC,
+    MIPS_KAISER,
+} mips_e;
+
+typedef struct {
+    convert_job_t **jobs;
+    int count;
+    atomic_int next;
+    bool force;
+    mips_e mips;
+    ini_t cache;
+} convert_ctx_t;
+
+#define FNV_PRIME_64  0x100000001b3ull
+#define FNV_OFFSET_64 0xcbf29ce484222325ull
+
+uint64 hash_fnv1a_64(uint64 hash, const void *buf, usize len) {
+    const uint8 *data = buf;
+
+    for (usize i = 0; i < len; ++i) {
+        hash = (hash ^ data[i]) * FNV_PRIME_64;
+    }
+
+    return hash;
+}
+
+bool is_image(strview_t path) {
+    strview_t exts[] = {
+        strv(".png"), strv(".jpg"), strv(".jpeg"), strv(".bmp"),
+        strv(".tga"), strv(".psd"), strv(".gif"), strv(".pnm"),
+    };
+
+    for (usize i = 0; i < arrlen(exts); ++i) {
+        if (strvEndsWithView(path, exts[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+convert_job_t *add_job(arena_t *arena, convert_job_t *head, strview_t from) {
+    convert_job_t *job = alloc(arena, convert_job_t);
+
+    usize ext = strvRFind(from, '.', 0);
+    job->from = str(arena, from);
+    job->to = strFmt(arena, "%v.raw", strvSub(from, 0, ext));
+    job->next = head;
+
+    return job;
+}
+
+convert_job_t *walk_dir(arena_t *arena, convert_job_t *head, strview_t dir) {
+#if COLLA_WIN
+    arena_t scratch = *arena;
+    str_t pattern = strFmt(&scratch, "%v/*", dir);
+
+    WIN32_FIND_DATAA data = {0};
+    HANDLE find = FindFirstFileA(pattern.buf, &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        err("couldn't open directory %v", dir);
+        return head;
+    }
+
+    do {
+        strview_t name = strv(data.cFileName);
+        if (strvEquals(name, strv(".")) || strvEquals(name, strv(".."))) {
+            continue;
+        }
+
+        str_t path = strFmt(arena, "%v/%v", dir, name);
+
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            head = walk_dir(arena, head, strv(path));
+        }
+        else if (is_image(name)) {
+            head = add_job(arena, head, strv(path));
+        }
+    } while (FindNextFileA(find, &data));
+
+    FindClose(find);
+#else
+    str_t dirname = str(arena, dir);
+    DIR *d = opendir(dirname.buf);
+    if (!d) {
+        err("couldn't open directory %v", dir);
+        return head;
+    }
+
+    struct dirent *entry = NULL;
+    while ((entry = readdir(d))) {
+        strview_t name = strv(entry->d_name);
+        if (strvEquals(name, strv(".")) || strvEquals(name, strv(".."))) {
+            continue;
+        }
+
+        str_t path = strFmt(arena, "%v/%v", dir, name);
+
+        struct stat st = {0};
+        if (stat(path.buf, &st) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            head = walk_dir(arena, head, strv(path));
+        }
+        else if (is_image(name)) {
+            head = add_job(arena, head, strv(path));
+        }
+    }
+
+    closedir(d);
+#endif
+    return head;
+}
+
+bool is_dir(strview_t path) {
+    char buf[4096];
+    if (path.len >= sizeof(buf)) return false;
+    memcpy(buf, path.buf, path.len);
+    buf[path.len] = '\0';
+#if COLLA_WIN
+    DWORD attr = GetFileAttributesA(buf);
+    return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st = {0};
+    return stat(buf, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+void convert_image(arena_t *arena, convert_job_t *job, bool force, mips_e mips) {
+    buffer_t in = fileReadWhole(arena, strv(job->from));
+    if (!in.data) {
+        err("couldn't read %v", job->from);
+        job->failed = true;
+        return;
+    }
+
+    job->in_size = in.len;
+    job->hash = hash_fnv1a_64(FNV_OFFSET_64, CONVERT_SETTINGS, sizeof(CONVERT_SETTINGS) - 1);
+    job->hash = hash_fnv1a_64(job->hash, &mips, sizeof(mips));
+    job->hash = hash_fnv1a_64(job->hash, in.data, in.len);
+
+    if (!force && job->hash == job->cached_hash && fileExists(job->to.buf)) {
+        return;
+    }
+
     int w, h;
-    uchar *p = stbi_load(from, &w, &h, NULL, 4);
+    uchar *p = stbi_load_from_memory(in.data, (int)in.len, &w, &h, NULL, 4);
+    if (!p) {
+        err("couldn't decode %v: %s", job->from, stbi_failure_reason());
+        job->failed = true;
+        return;
+    }
 
-    file_t fp = fileOpen(scratch, strv(to), FILE_WRITE);
+    // build the whole file in memory so it goes out in a single write
+    // mips, if any, follow the base level from largest to smallest
+    usize pixels_size = mips ? imgMipChainSize(w, h, IMG_RGBA8) : (usize)w * h * 4;
+    usize out_size = sizeof(uint16) * 2 + pixels_size;
+    uint8 *out = alloc(arena, uint8, out_size, ALLOC_NOZERO);
 
     uint16 width = w, height = h;
-    fileWrite(fp, &width, sizeof(width));
-    fileWrite(fp, &height, sizeof(height));
-    fileWrite(fp, p, w * h * 4);
+    memcpy(out, &width, sizeof(width));
+    memcpy(out + sizeof(width), &height, sizeof(height));
+
+    uint8 *pixels = out + sizeof(width) + sizeof(height);
+    memcpy(pixels, p, (usize)w * h * 4);
+
+    stbi_image_free(p);
+
+    if (mips) {
+        imgfilter_e filter = mips == MIPS_CUBIC ? IMG_FILTER_CUBIC : mips == MIPS_KAISER ? IMG_FILTER_KAISER : IMG_FILTER_BOX;
+        imgmips_t chain = imgBuildMips(arena, pixels, w, h, IMG_RGBA8, filter);
+        uint8 *dst = pixels + (usize)w * h * 4;
+        for (int i = 1; i < chain.count; ++i) {
+            usize level_size = (usize)chain.levels[i].width * chain.levels[i].height * 4;
+            memcpy(dst, chain.levels[i].pixels, level_size);
+            dst += level_size;
+        }
+    }
+
+    if (!fileWriteWhole(*arena, strv(job->to), out, out_size)) {
+        err("couldn't write %v", job->to);
+        job->failed = true;
+        return;
+    }
+
+    job->converted = true;
+}
+
+int convert_worker(void *userdata) {
+    convert_ctx_t *ctx = userdata;
+
+    int i;
+    while ((i = atomic_fetch_add(&ctx->next, 1)) < ctx->count) {
+        convert_job_t *job = ctx->jobs[i];
+
+        // allocating from the scratch arena itself, not a copy, lets arenaTempEnd see how
+        // far it went so a big image doesn't stay committed for the rest of the run
+        arena_temp_t scratch = arenaGetScratch(NULL, 0);
+        convert_image(scratch.arena, job, ctx->force, ctx->mips);
+        arenaTempEnd(scratch);
+
+        if (job->converted) {
+            info("converted %v to %v", job->from, job->to);
+        }
+    }
+
+    return 0;
+}
+
+// the ini parser has no quoting, so anything in a path that would split the key, start a comment
+// or a table, or get trimmed is written as %XX
+str_t cache_key(arena_t *arena, strview_t path) {
+    static const char hex[] = "0123456789ABCDEF";
+    char *buf = alloc(arena, char, path.len * 3 + 1);
+    usize len = 0;
+
+    for (usize i = 0; i < path.len; ++i) {
+        char c = path.buf[i];
+        switch (c) {
+            case '%': case '=': case ';': case '#': case '[': case ']':
+            case ' ': case '\t': case '\r': case '\n':
+                buf[len++] = '%';
+                buf[len++] = hex[(uint8)c >> 4];
+                buf[len++] = hex[c & 15];
+                break;
+            default:
+                buf[len++] = c;
+                break;
+        }
+    }
+
+    return (str_t){ buf, len };
+}
+
+str_t cache_path(arena_t *arena, strview_t key) {
+    char *buf = alloc(arena, char, key.len + 1);
+    usize len = 0;
+
+    for (usize i = 0; i < key.len; ++i) {
+        if (key.buf[i] == '%' && i + 2 < key.len) {
+            char hex[3] = { key.buf[i + 1], key.buf[i + 2], '\0' };
+            buf[len++] = (char)strtol(hex, NULL, 16);
+            i += 2;
+        }
+        else {
+            buf[len++] = key.buf[i];
+        }
+    }
+
+    return (str_t){ buf, len };
+}
+
+void load_cache(arena_t *arena, convert_ctx_t *ctx) {
+    if (!fileExists(CACHE_FILE)) {
+        return;
+    }
+
+    ctx->cache = iniParse(arena, strv(CACHE_FILE), NULL);
+    initable_t *root = iniGetTable(&ctx->cache, INI_ROOT);
+
+    for (int i = 0; i < ctx->count; ++i) {
+        convert_job_t *job = ctx->jobs[i];
+        arena_t scratch = *arena;
+        job->cached = iniGet(root, strv(cache_key(&scratch, strv(job->from))));
+        job->cached_hash = iniAsUInt(job->cached);
+    }
+}
+
+// true if a job of this run writes its own entry instead of value
+bool cache_replaced(convert_ctx_t *ctx, inivalue_t *value) {
+    for (int i = 0; i < ctx->count; ++i) {
+        if (ctx->jobs[i]->cached == value && !ctx->jobs[i]->failed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void save_cache(arena_t scratch, convert_ctx_t *ctx) {
+    file_t fp = fileOpen(scratch, strv(CACHE_FILE), FILE_WRITE);
+    if (!fileIsValid(fp)) {
+        err("couldn't write cache file %s", CACHE_FILE);
+        return;
+    }
+
+    obufstream_t out = obufInitSink(&scratch, KB(16), fileSink, &fp);
+
+    // runs on a subset of the inputs keep the entries of everything else, unless the input
+    // was deleted. failed jobs keep their old entry too
+    initable_t *root = iniGetTable(&ctx->cache, INI_ROOT);
+    for (inivalue_t *value = root ? root->values : NULL; value; value = value->next) {
+        arena_t tmp = scratch;
+        if (!cache_replaced(ctx, value) && fileExists(cache_path(&tmp, value->key).buf)) {
+            obufPrintf(&out, "%v = %v\n", value->key, value->value);
+        }
+    }
+
+    for (int i = 0; i < ctx->count; ++i) {
+        convert_job_t *job = ctx->jobs[i];
+        if (job->failed) {
+            continue;
+        }
+        arena_t tmp = scratch;
+        obufPrintf(&out, "%v = 0x%016llx\n", cache_key(&tmp, strv(job->from)), (unsigned long long)job->hash);
+    }
+
+    obufFlush(&out);
     fileClose(fp);
 }
 
 int main(int argc, char **argv) {
     if (argc < 2) {
-        fatal("usage: %s [ input images... ]", argv[0]);
+        fatal("usage: %s [ -j threads ] [ -f ] [ -m | -mc | -mk ] [ input images or directories... ]", argv[0]);
     }
 
-    arena_t arena = arenaMake(ARENA_VIRTUAL, MB(1));
+    stm_setup();
+
+    arena_t arena = arenaMake(ARENA_VIRTUAL, GB(1));
+
+    int num_threads = 4;
+    bool force = false;
+    mips_e mips = MIPS_NONE;
+    convert_job_t *head = NULL;
 
     for (int i = 1; i < argc; ++i) {
-        arena_t scratch = arena;
+        strview_t arg = strv(argv[i]);
+
+        if (strvEquals(arg, strv("-j"))) {
+            if (++i >= argc) {
+                fatal("passing -j option but no thread count passed!");
+            }
+            num_threads = atoi(argv[i]);
+        }
+        else if (strvEquals(arg, strv("-f"))) {
+            force = true;
+        }
+        else if (strvEquals(arg, strv("-m"))) {
+            mips = MIPS_BOX;
+        }
+        else if (strvEquals(arg, strv("-mc"))) {
+            mips = MIPS_CUBIC;
+        }
+        else if (strvEquals(arg, strv("-mk"))) {
+            mips = MIPS_KAISER;
+        }
+        else if (is_dir(arg)) {
+            head = walk_dir(&arena, head, arg);
+        }
+        else {
+            head = add_job(&arena, head, arg);
+        }
+    }
+
+    num_threads = num_threads < 1 ? 1 : num_threads > MAX_THREADS ? MAX_THREADS : num_threads;
 
-        const char *from = argv[i];
-        strview_t dir, name;
-        fileSplitPath(strv(from), &dir, &name, NULL);
-        str_t to = strFmt(&scratch, "%v/%v.raw", dir, name);
+    convert_ctx_t ctx = { .force = force, .mips = mips };
 
-        convert_image(scratch, from, to.buf);
-        info("converted %s to %v", from, to);
+    for_each (job, head) {
+        ctx.count++;
     }
 
-    return 0;
-}
\ No newline at end of file
+    ctx.jobs = alloc(&arena, convert_job_t *, ctx.count);
+    int index = ctx.count;
+    for_each (job, head) {
+        ctx.jobs[--index] = job;
+    }
+
+    load_cache(&arena, &ctx);
+
+    uint64 start = stm_now();
+
+    cthread_t threads[MAX_THREADS];
+    for (int i = 0; i < num_threads; ++i) {
+        threads[i] = thrCreate(convert_worker, &ctx);
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        thrJoin(threads[i], NULL);
+    }
+
+    double seconds = stm_sec(stm_since(start));
+
+    int converted = 0, skipped = 0, failed = 0;
+    usize total_bytes = 0;
+    for (int i = 0; i < ctx.count; ++i) {
+        convert_job_t *job = ctx.jobs[i];
+        converted += job->converted;
+        failed += job->failed;
+        skipped += !job->converted && !job->failed;
+        total_bytes += job->in_size;
+    }
+
+    save_cache(arena, &ctx);
+
+    double mb = (double)total_bytes / MB(1);
+    info(
+        "%d files (%d converted, %d up to date, %d failed) in %.3fs on %d threads: %.1f files/s, %.1f MB/s",
+        ctx.count, converted, skipped, failed, seconds, num_threads,
+        seconds > 0 ? ctx.count / seconds : 0.0,
+        seconds > 0 ? mb / seconds : 0.0
+    );
+
+    arenaCleanup(&arena);
+
+    return failed ? 1 : 0;
+}
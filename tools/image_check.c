@@ -0,0 +1,174 @@
+#include "../src/colla/build.c"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define SOKOL_TIME_IMPL
+#include "../src/sokol/sokol_time.h"
+
+// compares imgDownsample against plain reference filters over random sizes and formats,
+// then measures throughput on a big image. exits with 1 on any mismatch.
+// build it with and without simd (e.g. -mavx2) to check every path
+
+#define CHECK_RUNS 200
+#define CHECK_MAX_SIZE 300
+#define BENCH_SIZE 4096
+#define BENCH_REPS 10
+
+static uint32 rng_state = 0x12345678u;
+
+uint32 rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+int clampi(int v, int lo, int hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+int half(int v) {
+    return v > 1 ? v / 2 : 1;
+}
+
+void ref_box(const uint8 *src, int width, int height, uint8 *dst, int bpp) {
+    int dst_width = half(width);
+    int dst_height = half(height);
+
+    for (int oy = 0; oy < dst_height; ++oy) {
+        int y0 = oy * 2;
+        int y1 = clampi(y0 + 1, 0, height - 1);
+        for (int ox = 0; ox < dst_width; ++ox) {
+            int x0 = ox * 2;
+            int x1 = clampi(x0 + 1, 0, width - 1);
+            for (int c = 0; c < bpp; ++c) {
+                uint32 sum =
+                    src[(y0 * width + x0) * bpp + c] + src[(y0 * width + x1) * bpp + c] +
+                    src[(y1 * width + x0) * bpp + c] + src[(y1 * width + x1) * bpp + c];
+                dst[(oy * dst_width + ox) * bpp + c] = (uint8)((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+// same taps as image.c, but in doubles without intermediate rounding
+static const double cubic_weights[8]  = { -3, -9, 29, 111, 111, 29, -9, -3 };
+static const double kaiser_weights[8] = { -3, -11, 30, 112, 112, 30, -11, -3 };
+
+void ref_filter8(const uint8 *src, int width, int height, uint8 *dst, int bpp, const double *weights) {
+    int dst_width = half(width);
+    int dst_height = half(height);
+
+    for (int oy = 0; oy < dst_height; ++oy) {
+        for (int ox = 0; ox < dst_width; ++ox) {
+            for (int c = 0; c < bpp; ++c) {
+                double sum = 0;
+                for (int ky = 0; ky < 8; ++ky) {
+                    int sy = clampi(oy * 2 - 3 + ky, 0, height - 1);
+                    double row = 0;
+                    for (int kx = 0; kx < 8; ++kx) {
+                        int sx = clampi(ox * 2 - 3 + kx, 0, width - 1);
+                        row += weights[kx] * src[(sy * width + sx) * bpp + c];
+                    }
+                    sum += weights[ky] * row;
+                }
+                int v = (int)floor(sum / (256.0 * 256.0) + 0.5);
+                dst[(oy * dst_width + ox) * bpp + c] = (uint8)clampi(v, 0, 255);
+            }
+        }
+    }
+}
+
+// returns the biggest difference between the two outputs
+int compare(arena_t scratch, imgformat_e format, imgfilter_e filter, int width, int height) {
+    usize src_size = (usize)width * height * format;
+    usize dst_size = (usize)half(width) * half(height) * format;
+
+    uint8 *src = alloc(&scratch, uint8, src_size, ALLOC_NOZERO);
+    uint8 *got = alloc(&scratch, uint8, dst_size, ALLOC_NOZERO);
+    uint8 *want = alloc(&scratch, uint8, dst_size, ALLOC_NOZERO);
+
+    for (usize i = 0; i < src_size; ++i) {
+        src[i] = (uint8)rng();
+    }
+
+    imgDownsample(scratch, src, width, height, got, format, filter);
+    switch (filter) {
+        case IMG_FILTER_BOX:    ref_box(src, width, height, want, format); break;
+        case IMG_FILTER_CUBIC:  ref_filter8(src, width, height, want, format, cubic_weights); break;
+        case IMG_FILTER_KAISER: ref_filter8(src, width, height, want, format, kaiser_weights); break;
+    }
+
+    int max_diff = 0;
+    for (usize i = 0; i < dst_size; ++i) {
+        int diff = abs((int)got[i] - (int)want[i]);
+        max_diff = diff > max_diff ? diff : max_diff;
+    }
+    return max_diff;
+}
+
+double bench(arena_t scratch, imgformat_e format, imgfilter_e filter) {
+    usize src_size = (usize)BENCH_SIZE * BENCH_SIZE * format;
+    uint8 *src = alloc(&scratch, uint8, src_size, ALLOC_NOZERO);
+    uint8 *dst = alloc(&scratch, uint8, src_size / 4, ALLOC_NOZERO);
+
+    for (usize i = 0; i < src_size; ++i) {
+        src[i] = (uint8)rng();
+    }
+
+    // warm up, so page faults aren't measured
+    imgDownsample(scratch, src, BENCH_SIZE, BENCH_SIZE, dst, format, filter);
+
+    uint64 best = UINT64_MAX;
+    for (int i = 0; i < BENCH_REPS; ++i) {
+        uint64 start = stm_now();
+        imgDownsample(scratch, src, BENCH_SIZE, BENCH_SIZE, dst, format, filter);
+        uint64 elapsed = stm_since(start);
+        best = elapsed < best ? elapsed : best;
+    }
+
+    // source pixels per second
+    return (double)BENCH_SIZE * BENCH_SIZE / stm_sec(best) / 1e6;
+}
+
+int main(void) {
+    stm_setup();
+
+    arena_t arena = arenaMake(ARENA_VIRTUAL, GB(1));
+
+    imgformat_e formats[] = { IMG_R8, IMG_RG8, IMG_RGBA8 };
+    const char *format_names[] = { "R8", "RG8", "RGBA8" };
+    imgfilter_e filters[] = { IMG_FILTER_BOX, IMG_FILTER_CUBIC, IMG_FILTER_KAISER };
+    const char *filter_names[] = { "box", "cubic", "kaiser" };
+    // the box filter has to match exactly, the 8 tap ones round their fixed point sums
+    int tolerance[] = { 0, 1, 1 };
+
+    info("simd: avx2 %d, sse2 %d", IMG_AVX2, IMG_SSE2);
+
+    bool failed = false;
+
+    for (usize f = 0; f < arrlen(filters); ++f) {
+        for (usize fmt = 0; fmt < arrlen(formats); ++fmt) {
+            int worst = 0;
+            for (int run = 0; run < CHECK_RUNS; ++run) {
+                // small sizes first, they hit the edge cases of the simd loops
+                int width = run < 32 ? run + 1 : (int)(rng() % CHECK_MAX_SIZE) + 1;
+                int height = run < 32 ? 32 - run : (int)(rng() % CHECK_MAX_SIZE) + 1;
+                int diff = compare(arena, formats[fmt], filters[f], width, height);
+                if (diff > tolerance[f]) {
+                    err("%s %s %dx%d: off by %d", filter_names[f], format_names[fmt], width, height, diff);
+                    failed = true;
+                }
+                worst = diff > worst ? diff : worst;
+            }
+
+            double mpix = bench(arena, formats[fmt], filters[f]);
+            info("%-6s %-5s max diff %d, %.0f MPix/s on %dx%d", filter_names[f], format_names[fmt], worst, mpix, BENCH_SIZE, BENCH_SIZE);
+        }
+    }
+
+    arenaCleanup(&arena);
+
+    return failed ? 1 : 0;
+}